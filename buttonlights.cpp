@@ -0,0 +1,117 @@
+#include <QDebug>
+#include "buttonlights.h"
+
+// byte offsets of the named LEDs in the 0x80 report (byte 0 is the report id)
+static const struct
+	{
+	const char *name;
+	int offset;
+	} ledOffsets[] =
+	{
+	{ "presetUp", 23 },
+	{ "presetDown", 28 },
+	{ "pageLeft", 33 },
+	{ "pageRight", 34 }
+	};
+
+static const int reportLength = 105;
+
+buttonLights::buttonLights(QObject *parent) : QObject(parent)
+{
+	lights = QByteArray(reportLength, '\0');
+	lights[0] = 0x80;
+	setRate(60);
+	clock.start();
+	timer.setSingleShot(true);
+	timer.setTimerType(Qt::PreciseTimer);
+	connect(&timer, SIGNAL(timeout()), this, SLOT(tick()));
+}
+
+// offset of a named LED in the report, -1 for unknown names
+int buttonLights::offset(const QString &name)
+{
+	for(unsigned int i=0;i<sizeof(ledOffsets)/sizeof(ledOffsets[0]);i++)
+		if(name == ledOffsets[i].name)
+			return ledOffsets[i].offset;
+	return -1;
+}
+
+// switch an LED to a brightness with the next tick, a fade of this LED is stopped
+void buttonLights::set(const QString &name, quint8 level)
+{
+	fade(name, level, 0);
+}
+
+// move an LED from its current brightness to level within duration milliseconds
+void buttonLights::fade(const QString &name, quint8 level, int duration)
+{
+	int position = offset(name);
+	if(position < 0)
+		{
+		qDebug() << "lights: unknown LED" << name;
+		return;
+		}
+	for(int i=0;i<fades.count();i++)
+		if(fades[i].offset == position)
+			fades.removeAt(i--);
+	if(duration <= 0)
+		lights[position] = level;
+	else
+		{
+		runningFade f;
+		f.offset = position;
+		f.from = lights[position];
+		f.to = level;
+		f.start = clock.elapsed();
+		f.duration = duration;
+		fades.append(f);
+		}
+	schedule();
+}
+
+// the brightness currently in the report (during a fade the value of the last tick)
+quint8 buttonLights::level(const QString &name) const
+{
+	int position = offset(name);
+	return position < 0 ? 0 : quint8(lights[position]);
+}
+
+// the complete 0x80 report
+QByteArray buttonLights::report() const
+{
+	return lights;
+}
+
+void buttonLights::setRate(int framesPerSecond)
+{
+	period = 1000/qBound(1, framesPerSecond, 1000);
+}
+
+// start the frame clock unless it is running, a change after an idle period is applied right away
+void buttonLights::schedule()
+{
+	if(timer.isActive())
+		return;
+	timer.start(lastTick.isValid() ? qMax<qint64>(0, period-lastTick.elapsed()) : 0);
+}
+
+void buttonLights::tick()
+{
+	lastTick.start();
+	qint64 now = clock.elapsed();
+	for(int i=0;i<fades.count();i++)
+		{
+		const runningFade &f = fades[i];
+		qint64 progress = qMin(now-f.start, f.duration);
+		lights[f.offset] = quint8(f.from + (int(f.to)-int(f.from))*progress/f.duration);
+		if(progress == f.duration)
+			fades.removeAt(i--);
+		}
+	if(!fades.isEmpty())
+		timer.start(period);
+
+	if(lights == sent)
+		return;
+	sent = lights;
+	emit changed();
+}
@@ -0,0 +1,54 @@
+#ifndef _BUTTONLIGHTS_H_
+#define _BUTTONLIGHTS_H_
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+// brightness of the button LEDs, kept as the 0x80 output report and addressed by button name.
+// changes and running fades are applied on a frame clock: everything changed within one tick
+// results in one changed() signal, a tick which leaves the report as it was sends nothing
+class buttonLights : public QObject
+{
+	Q_OBJECT
+
+	public:
+		enum brightness { off = 0x00, dim = 0x40, on = 0xff };
+
+		explicit buttonLights(QObject *parent = 0);
+		void set(const QString &name, quint8 level);
+		void fade(const QString &name, quint8 level, int duration);
+		quint8 level(const QString &name) const;
+		QByteArray report() const;
+		void setRate(int framesPerSecond);
+		static int offset(const QString &name);
+
+	signals:
+		void changed();
+
+	private slots:
+		void tick();
+
+	private:
+		// an LED moving from one brightness to another, times in milliseconds of the frame clock
+		struct runningFade
+			{
+			int offset;
+			quint8 from, to;
+			qint64 start, duration;
+			};
+
+		void schedule();
+
+		QByteArray lights, sent;
+		QList<runningFade> fades;
+		int period; // milliseconds
+		QTimer timer;
+		QElapsedTimer clock, lastTick;
+};
+
+#endif /*_BUTTONLIGHTS_H_*/
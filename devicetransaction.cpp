@@ -0,0 +1,132 @@
+#include <QDateTime>
+#include "devicetransaction.h"
+
+deviceTransaction::deviceTransaction(const QList<kontrolDevice *> &devices, QObject *parent) : QObject(parent)
+{
+	current = collecting;
+	starting = false;
+	keyboards = devices;
+	duration = 0;
+	finishedAt = 0;
+}
+
+// reports are written in the order they were added
+void deviceTransaction::addReport(const QString &name, const QByteArray &report)
+{
+	reports.append(qMakePair(name, report));
+}
+
+// frames are sent by priority, see kontrolDevice::drawFrame()
+void deviceTransaction::addFrame(uint8_t screen, const QImage &frame, int x, int y, int priority)
+{
+	queuedFrame f;
+	f.screen = screen;
+	f.image = frame.convertToFormat(QImage::Format_RGB16);
+	f.x = x;
+	f.y = y;
+	f.priority = priority;
+	frames.append(f);
+}
+
+// hand everything to the keyboards without waiting for any of it
+void deviceTransaction::start()
+{
+	if(current != collecting)
+		return;
+	current = running;
+	starting = true; // a frame replaced while queueing must not finish the transaction early
+	clock.start();
+
+	for(kontrolDevice *keyboard : keyboards)
+		{
+		// frames first: the display threads start on them while the reports are written
+		connect(keyboard, SIGNAL(frameSent(quint64, int)), this, SLOT(frameSent(quint64, int)));
+		for(const queuedFrame &f : frames)
+			for(quint64 id : keyboard->drawFrame(f.screen, f.image, f.x, f.y, f.priority))
+				if(!replaced[keyboard].remove(id))
+					sending[keyboard].insert(id);
+
+		if(reports.isEmpty())
+			continue;
+		QFutureWatcher<QList<int> > *watcher = new QFutureWatcher<QList<int> >(this);
+		writes[watcher] = keyboard;
+		connect(watcher, SIGNAL(finished()), this, SLOT(reportsWritten()));
+		watcher->setFuture(keyboard->writeReports(reports));
+		}
+	starting = false;
+	replaced.clear();
+	finishIfComplete();
+}
+
+deviceTransaction::state deviceTransaction::currentState() const
+{
+	return current;
+}
+
+bool deviceTransaction::succeeded() const
+{
+	return (current == finished) && failed.isEmpty();
+}
+
+// one line per failed report or frame: keyboard, step and libusb or hidapi error code
+QStringList deviceTransaction::failures() const
+{
+	return failed;
+}
+
+// nanoseconds from start() until the last report and frame were sent
+qint64 deviceTransaction::latency() const
+{
+	return duration;
+}
+
+// completion time in milliseconds since the epoch, 0 while running
+qint64 deviceTransaction::completedAt() const
+{
+	return finishedAt;
+}
+
+void deviceTransaction::reportsWritten()
+{
+	QFutureWatcher<QList<int> > *watcher = static_cast<QFutureWatcher<QList<int> > *>(sender());
+	kontrolDevice *keyboard = writes.take(watcher);
+	QList<int> results = watcher->result();
+	for(int i=0;i<results.count();i++)
+		if(results[i] < 0)
+			failed.append(keyboard->name()+": report "+reports[i].first+" ("+QString::number(results[i])+")");
+	watcher->deleteLater();
+	finishIfComplete();
+}
+
+void deviceTransaction::frameSent(quint64 id, int result)
+{
+	kontrolDevice *keyboard = qobject_cast<kontrolDevice *>(sender());
+	if(!keyboard)
+		return;
+	if(!sending[keyboard].remove(id))
+		{
+		// our own frame, replaced by a later one of this transaction before drawFrame() returned its id
+		if(starting && (result == 0))
+			replaced[keyboard].insert(id);
+		return; // otherwise a frame of someone else
+		}
+	if(result < 0)
+		failed.append(keyboard->name()+": frame "+QString::number(id)+" ("+QString::number(result)+")");
+	finishIfComplete();
+}
+
+void deviceTransaction::finishIfComplete()
+{
+	if((current != running) || starting || !writes.isEmpty())
+		return;
+	for(QMap<kontrolDevice *, QSet<quint64> >::const_iterator i = sending.constBegin(); i != sending.constEnd(); ++i)
+		if(!i.value().isEmpty())
+			return;
+
+	current = finished;
+	duration = clock.nsecsElapsed();
+	finishedAt = QDateTime::currentMSecsSinceEpoch();
+	for(kontrolDevice *keyboard : keyboards)
+		disconnect(keyboard, SIGNAL(frameSent(quint64, int)), this, SLOT(frameSent(quint64, int)));
+	emit done(this);
+}
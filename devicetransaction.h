@@ -0,0 +1,68 @@
+#ifndef _DEVICETRANSACTION_H_
+#define _DEVICETRANSACTION_H_
+
+#include <QtGlobal>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include "kontroldevice.h"
+
+// a group of HID reports and screen frames which belong together (e.g. applying a preset), sent to
+// one or more keyboards as a unit. the reports go out back to back on the output thread of every
+// keyboard while the display threads send the frames, the GUI thread only collects the completions.
+// states: collecting -> running -> finished; done() comes once with the failed steps (if any)
+class deviceTransaction : public QObject
+{
+	Q_OBJECT
+
+	public:
+		enum state { collecting, running, finished };
+
+		explicit deviceTransaction(const QList<kontrolDevice *> &devices, QObject *parent = 0);
+		void addReport(const QString &name, const QByteArray &report);
+		void addFrame(uint8_t screen, const QImage &frame, int x = 0, int y = 0, int priority = 0);
+		void start();
+		state currentState() const;
+		bool succeeded() const;
+		QStringList failures() const;
+		qint64 latency() const;
+		qint64 completedAt() const;
+
+	signals:
+		void done(deviceTransaction *transaction);
+
+	private slots:
+		void reportsWritten();
+		void frameSent(quint64 id, int result);
+
+	private:
+		struct queuedFrame
+			{
+			uint8_t screen;
+			QImage image;
+			int x, y;
+			int priority;
+			};
+
+		void finishIfComplete();
+
+		state current;
+		bool starting;
+		QList<kontrolDevice *> keyboards;
+		QList<QPair<QString,QByteArray> > reports;
+		QList<queuedFrame> frames;
+		QMap<QFutureWatcher<QList<int> > *, kontrolDevice *> writes; // still running
+		QMap<kontrolDevice *, QSet<quint64> > sending; // frame ids not sent yet
+		QMap<kontrolDevice *, QSet<quint64> > replaced; // sent before start() knew their id
+		QStringList failed;
+		QElapsedTimer clock;
+		qint64 duration, finishedAt; // nanoseconds, milliseconds since the epoch
+};
+
+#endif /*_DEVICETRANSACTION_H_*/
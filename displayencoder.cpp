@@ -0,0 +1,235 @@
+#include <string.h>
+#include <QtEndian>
+#include "displayencoder.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISPLAYENCODER_X86
+#include <immintrin.h>
+#endif
+
+// the display expects every RGB565 pixel with the high byte first
+static void packScalar(uchar *out, const ushort *pixels, int count)
+{
+	for(int i=0;i<count;i++)
+		qToBigEndian<quint16>(pixels[i], out+2*i);
+}
+
+#ifdef DISPLAYENCODER_X86
+__attribute__((target("sse2")))
+static void packSSE2(uchar *out, const ushort *pixels, int count)
+{
+	int i = 0;
+	for(;i+8<=count;i+=8)
+		{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels+i));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out+2*i), v);
+		}
+	packScalar(out+2*i, pixels+i, count-i);
+}
+
+__attribute__((target("avx2")))
+static void packAVX2(uchar *out, const ushort *pixels, int count)
+{
+	const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+					      1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	int i = 0;
+	for(;i+16<=count;i+=16)
+		{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixels+i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out+2*i), _mm256_shuffle_epi8(v, swap));
+		}
+	packSSE2(out+2*i, pixels+i, count-i);
+}
+#endif
+
+typedef void (*packFunction)(uchar *, const ushort *, int);
+struct packKernel
+	{
+	packFunction function;
+	const char *name;
+	};
+
+// the kernels the CPU supports, the widest last
+static QList<packKernel> supportedKernels()
+{
+	QList<packKernel> kernels;
+	packKernel scalar = { packScalar, "scalar" };
+	kernels.append(scalar);
+#ifdef DISPLAYENCODER_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		{
+		packKernel sse2 = { packSSE2, "sse2" };
+		kernels.append(sse2);
+		}
+	if(__builtin_cpu_supports("avx2"))
+		{
+		packKernel avx2 = { packAVX2, "avx2" };
+		kernels.append(avx2);
+		}
+#endif
+	return kernels;
+}
+
+// the widest kernel is picked once per process
+static packKernel kernel = supportedKernels().last();
+
+// a repeat block costs 8 bytes and splits the literal stream, so it pays off from 4 equal pixel pairs on
+static const int minimumRun = 4;
+
+// walks the pixel pairs of the area in raster order along a scanline pointer, a pair of an odd
+// width area may start at the end of one row and end at the beginning of the next
+class pairReader
+{
+	public:
+		pairReader(const QImage &image, const QRect &source) : image(image), source(source)
+		{
+			row = 0;
+			column = 0;
+			line = reinterpret_cast<const ushort *>(image.constScanLine(source.top()))+source.left();
+		}
+
+		// the next pair, the first pixel in the low half
+		inline quint32 next()
+		{
+			quint32 pair = pixel();
+			return pair | (quint32(pixel()) << 16);
+		}
+
+	private:
+		inline ushort pixel()
+		{
+			ushort value = line[column];
+			if(++column == source.width())
+				{
+				column = 0;
+				if(++row < source.height())
+					line = reinterpret_cast<const ushort *>(image.constScanLine(source.top()+row))+source.left();
+				}
+			return value;
+		}
+
+		const QImage &image;
+		const QRect &source;
+		const ushort *line;
+		int row, column;
+};
+
+// opcode 00: the pairs [first, last) as literal pixels, packed scanline segment by scanline segment
+static uchar *writeLiteral(uchar *p, const QImage &image, const QRect &source, int first, int last)
+{
+	const int count = last-first;
+	*p++ = 0x00; *p++ = (count >> 16) & 0xff; *p++ = (count >> 8) & 0xff; *p++ = count & 0xff;
+	for(int pixel=2*first; pixel<2*last;)
+		{
+		const int row = pixel/source.width();
+		const int column = pixel%source.width();
+		const int n = qMin(source.width()-column, 2*last-pixel);
+		kernel.function(p, reinterpret_cast<const ushort *>(image.constScanLine(source.top()+row))+source.left()+column, n);
+		p += 2*n;
+		pixel += n;
+		}
+	return p;
+}
+
+// opcode 01: one pixel pair which the display repeats count times
+static uchar *writeFill(uchar *p, quint32 pair, int count)
+{
+	*p++ = 0x01; *p++ = (count >> 16) & 0xff; *p++ = (count >> 8) & 0xff; *p++ = count & 0xff;
+	qToBigEndian<quint16>(pair & 0xffff, p); p += 2;
+	qToBigEndian<quint16>(pair >> 16, p); p += 2;
+	return p;
+}
+
+// upper bound of the command size: header, block opcode, all pixels as literals and trailer
+int displayEncoder::frameSize(int width, int height)
+{
+	return 16 + 8 + width*height*2 + 12;
+}
+
+// write the command which draws the area of the image (all of it if empty) at x/y on the given screen,
+// out must hold frameSize() bytes; runs of equal pixel pairs become repeat blocks, the rest literal blocks.
+// the pixel blocks are counted in pixel pairs, an area with an odd number of pixels can't be encoded (-1)
+int displayEncoder::encode(uchar *out, uint8_t screen, const QImage &image, int x, int y, const QRect &area)
+{
+	const QRect source = area.isEmpty() ? image.rect() : area;
+	if((source.width()*source.height()) % 2)
+		return -1;
+	const int pairs = source.width()*source.height()/2;
+	uchar *p = out;
+
+	// header: 84 00 <screen> 60 00 00 00 00 <x> <y> <width> <height>, all 16 bit big-endian
+	*p++ = 0x84; *p++ = 0x00; *p++ = screen; *p++ = 0x60;
+	*p++ = 0x00; *p++ = 0x00; *p++ = 0x00; *p++ = 0x00;
+	qToBigEndian<quint16>(x, p); p += 2;
+	qToBigEndian<quint16>(y, p); p += 2;
+	qToBigEndian<quint16>(source.width(), p); p += 2;
+	qToBigEndian<quint16>(source.height(), p); p += 2;
+	*p++ = 0x02; *p++ = 0x00; *p++ = 0x00; *p++ = 0x00;
+
+	// split the pairs into literal and repeat blocks, every pair is read once: a run of equal
+	// pairs [start, k) ends at the first different pair or at the end of the area
+	int literal = 0, start = 0;
+	pairReader reader(image, source);
+	quint32 pair = reader.next();
+	for(int k=1; k<=pairs; k++)
+		{
+		quint32 next = 0;
+		if(k < pairs)
+			{
+			next = reader.next();
+			if(next == pair)
+				continue;
+			}
+		if(k-start >= minimumRun)
+			{
+			if(literal < start)
+				p = writeLiteral(p, image, source, literal, start);
+			p = writeFill(p, pair, k-start);
+			literal = k;
+			}
+		start = k;
+		pair = next;
+		}
+	if(literal < pairs)
+		p = writeLiteral(p, image, source, literal, pairs);
+
+	// trailer: 02 00 00 00 03 00 00 00 40 00 00 00
+	static const uchar trailer[12] = { 0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00 };
+	memcpy(p, trailer, sizeof(trailer));
+	p += sizeof(trailer);
+	return p - out;
+}
+
+void displayEncoder::packPixels(uchar *out, const ushort *pixels, int count)
+{
+	kernel.function(out, pixels, count);
+}
+
+const char *displayEncoder::kernelName()
+{
+	return kernel.name;
+}
+
+// names of the kernels this CPU can run, narrowest first
+QStringList displayEncoder::kernelNames()
+{
+	QStringList names;
+	for(const packKernel &k : supportedKernels())
+		names.append(k.name);
+	return names;
+}
+
+// use another kernel, for checks and benchmarks only: no frame may be encoded meanwhile.
+// false if the CPU does not support it
+bool displayEncoder::setKernel(const QString &name)
+{
+	for(const packKernel &k : supportedKernels())
+		if(name == k.name)
+			{
+			kernel = k;
+			return true;
+			}
+	return false;
+}
@@ -0,0 +1,20 @@
+#ifndef _DISPLAYENCODER_H_
+#define _DISPLAYENCODER_H_
+
+#include <QImage>
+#include <QStringList>
+
+// builds the 0x84 display command for a RGB16 image: 16 byte header, the big-endian RGB565
+// payload as literal and repeat blocks and the 12 byte trailer, written straight into a sized buffer
+class displayEncoder
+{
+	public:
+		static int frameSize(int width, int height);
+		static int encode(uchar *out, uint8_t screen, const QImage &image, int x, int y, const QRect &area = QRect());
+		static void packPixels(uchar *out, const ushort *pixels, int count);
+		static const char *kernelName();
+		static QStringList kernelNames();
+		static bool setKernel(const QString &name);
+};
+
+#endif /*_DISPLAYENCODER_H_*/
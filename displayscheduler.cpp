@@ -0,0 +1,129 @@
+#include "displayscheduler.h"
+
+displayScheduler::displayScheduler(QObject *parent) : QObject(parent)
+{
+	ticks = 0;
+	merged = 0;
+	setRate(60);
+	timer.setSingleShot(true);
+	timer.setTimerType(Qt::PreciseTimer);
+	connect(&timer, SIGNAL(timeout()), this, SLOT(tick()));
+}
+
+// a region of a screen which is refreshed as a whole, a higher priority is flushed first. maximumRate
+// limits its refreshes per second, requests in between are merged. returns the id for request()
+int displayScheduler::addRegion(const QString &name, int screen, int priority, int maximumRate)
+{
+	displayRegion r;
+	r.name = name;
+	r.screen = screen;
+	r.priority = priority;
+	r.period = 1000/qBound(1, maximumRate, 1000);
+	r.pending = 0;
+	regions.append(r);
+	return regions.count()-1;
+}
+
+// id of a region, -1 if it does not exist
+int displayScheduler::region(const QString &name, int screen) const
+{
+	for(int i=0;i<regions.count();i++)
+		if((regions[i].name == name) && (regions[i].screen == screen))
+			return i;
+	return -1;
+}
+
+QString displayScheduler::name(int region) const
+{
+	return regions[region].name;
+}
+
+// upper limit of ticks per second for all regions
+void displayScheduler::setRate(int framesPerSecond)
+{
+	period = 1000/qBound(1, framesPerSecond, 1000);
+}
+
+int displayScheduler::rate() const
+{
+	return 1000/period;
+}
+
+// mark items of a region as changed. the first request after an idle period is flushed right away,
+// everything arriving until the region is due again is merged into one flush
+void displayScheduler::request(int region, quint32 items)
+{
+	if(!items || (region < 0) || (region >= regions.count()))
+		return;
+	displayRegion &r = regions[region];
+	if(r.pending & items)
+		merged++;
+	r.pending |= items;
+	qint64 wait = lastTick.isValid() ? qMax<qint64>(0, period-lastTick.elapsed()) : 0;
+	schedule(qMax<qint64>(wait, dueIn(r)));
+}
+
+// milliseconds until the maximum rate allows the next flush of a region
+int displayScheduler::dueIn(const displayRegion &r) const
+{
+	if(!r.lastFlush.isValid())
+		return 0;
+	return qMax<qint64>(0, r.period-r.lastFlush.elapsed());
+}
+
+void displayScheduler::schedule(int wait)
+{
+	if(timer.isActive() && (timer.remainingTime() <= wait))
+		return;
+	timer.start(qMax(0, wait));
+}
+
+void displayScheduler::tick()
+{
+	lastTick.start();
+	ticks++;
+
+	// due regions by priority, equal ones in the order they were added
+	QList<int> due;
+	for(int i=0;i<regions.count();i++)
+		{
+		if(!regions[i].pending || dueIn(regions[i]))
+			continue;
+		int at = 0;
+		while((at < due.count()) && (regions[due[at]].priority >= regions[i].priority))
+			at++;
+		due.insert(at, i);
+		}
+
+	for(int i : due)
+		{
+		displayRegion &r = regions[i];
+		quint32 items = r.pending;
+		r.pending = 0;
+		r.lastFlush.start();
+		emit flush(i, items);
+		}
+
+	// wake up again for the regions left over
+	int wait = -1;
+	for(const displayRegion &r : regions)
+		if(r.pending)
+			{
+			int next = qMax(period, dueIn(r));
+			if((wait < 0) || (next < wait))
+				wait = next;
+			}
+	if(wait >= 0)
+		schedule(wait);
+}
+
+quint64 displayScheduler::tickCount() const
+{
+	return ticks;
+}
+
+// requests for items which were still pending, they cost no extra transfer
+quint64 displayScheduler::mergedCount() const
+{
+	return merged;
+}
@@ -0,0 +1,58 @@
+#ifndef _DISPLAYSCHEDULER_H_
+#define _DISPLAYSCHEDULER_H_
+
+#include <QtGlobal>
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+// paces screen updates: named regions of the screens (e.g. the knob values) each have a priority and a
+// maximum refresh rate. requests are collected per region as a bitmask of items and flushed on the next
+// tick, the due regions highest priority first. the timer only runs while something is pending, an
+// unchanged display costs nothing. what a region covers and how its frames are ordered on the way to
+// the keyboard is up to the flush handler, the transfer queue sends them by their priority
+class displayScheduler : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit displayScheduler(QObject *parent = 0);
+		int addRegion(const QString &name, int screen, int priority, int maximumRate);
+		int region(const QString &name, int screen) const;
+		QString name(int region) const;
+		void setRate(int framesPerSecond);
+		int rate() const;
+		void request(int region, quint32 items = 1);
+		quint64 tickCount() const;
+		quint64 mergedCount() const;
+
+	signals:
+		void flush(int region, quint32 items);
+
+	private slots:
+		void tick();
+
+	private:
+		struct displayRegion
+			{
+			QString name;
+			int screen;
+			int priority;
+			int period; // milliseconds between two flushes
+			quint32 pending;
+			QElapsedTimer lastFlush;
+			};
+
+		int dueIn(const displayRegion &r) const;
+		void schedule(int wait);
+
+		QList<displayRegion> regions;
+		int period; // milliseconds
+		QTimer timer;
+		QElapsedTimer lastTick;
+		quint64 ticks, merged;
+};
+
+#endif /*_DISPLAYSCHEDULER_H_*/
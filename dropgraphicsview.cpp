@@ -30,6 +30,7 @@ scene.clear();
 currentFile = QUrl(mimeData->text()).toLocalFile().trimmed();
 scene.addPixmap(QPixmap(currentFile).scaled(this->width()-4, this->height()-4, Qt::IgnoreAspectRatio,Qt::SmoothTransformation));
 event->acceptProposedAction();
+emit imageChanged();
 }
 
 void dropGraphicsView::setImage(QString file)
@@ -37,6 +38,7 @@ void dropGraphicsView::setImage(QString file)
 scene.clear();
 currentFile = file;
 scene.addPixmap(QPixmap(currentFile).scaled(this->width()-4, this->height()-4, Qt::IgnoreAspectRatio,Qt::SmoothTransformation));
+emit imageChanged();
 }
 
 dropGraphicsView::~dropGraphicsView()
@@ -26,6 +26,9 @@ class dropGraphicsView : public QGraphicsView
 		void dragMoveEvent(QDragMoveEvent *event);
 		void dropEvent(QDropEvent *event);
 
+	signals:
+		void imageChanged();
+
 	protected slots:
 
 	public slots:
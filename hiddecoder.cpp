@@ -0,0 +1,86 @@
+#include <string.h>
+#include <QtAlgorithms>
+#include "hiddecoder.h"
+
+// known input reports: id, exact length and the function which decodes them
+struct reportLayout
+	{
+	unsigned char id;
+	int length;
+	int (hidDecoder::*decode)(const unsigned char *, kontrolEvent *);
+	};
+
+hidDecoder::hidDecoder()
+{
+	reset();
+}
+
+// decode one report into the state and write its edge events, returns the number of events
+// (at most maxEvents); reports of unknown id or length are ignored
+int hidDecoder::decode(const unsigned char *report, int length, kontrolEvent *events)
+{
+	static const reportLayout layouts[] =
+		{
+		{ 0x01, 32, &hidDecoder::decodeButtons },
+		{ 0xaa, 51, &hidDecoder::decodeKnobs }
+		};
+
+	if(length < 1)
+		return 0;
+	for(unsigned int i=0;i<sizeof(layouts)/sizeof(layouts[0]);i++)
+		if((report[0] == layouts[i].id) && (length == layouts[i].length))
+			return (this->*layouts[i].decode)(report, events);
+	return 0;
+}
+
+const kontrolState &hidDecoder::state() const
+{
+	return current;
+}
+
+void hidDecoder::reset()
+{
+	memset(&current, 0, sizeof(current));
+}
+
+// 0x01: one bit per button in bytes 1-8, every changed bit is an edge
+int hidDecoder::decodeButtons(const unsigned char *report, kontrolEvent *events)
+{
+	quint64 buttons = 0;
+	for(int i=0;i<8;i++)
+		buttons |= quint64(report[1+i]) << (8*i);
+
+	int count = 0;
+	quint64 changed = buttons ^ current.buttons;
+	while(changed)
+		{
+		const int bit = qCountTrailingZeroBits(changed);
+		kontrolEvent &e = events[count++];
+		e.type = (buttons >> bit) & 1 ? kontrolEvent::buttonDown : kontrolEvent::buttonUp;
+		e.index = bit;
+		e.value = 0;
+		e.delta = 0;
+		changed &= changed-1;
+		}
+	current.buttons = buttons;
+	return count;
+}
+
+// 0xaa: the encoder values are found at bytes 17, 19, ... 31
+int hidDecoder::decodeKnobs(const unsigned char *report, kontrolEvent *events)
+{
+	int count = 0;
+	for(int i=0;i<8;i++)
+		{
+		const quint8 value = report[17+i*2];
+		if(value == current.knobs[i])
+			continue;
+		kontrolEvent &e = events[count++];
+		e.type = kontrolEvent::knobChange;
+		e.index = i;
+		e.value = value;
+		e.delta = qint16(value) - current.knobs[i];
+		current.knobs[i] = value;
+		}
+	return count;
+}
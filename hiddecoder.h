@@ -0,0 +1,52 @@
+#ifndef _HIDDECODER_H_
+#define _HIDDECODER_H_
+
+#include <QtGlobal>
+
+// buttons of the 0x01 report, the value is the bit number in kontrolState::buttons
+enum kontrolButton
+	{
+	buttonStop = 16,
+	buttonRec = 17,
+	buttonPlay = 12,
+	buttonPresetUp = 20,
+	buttonPageRight = 21,
+	buttonPresetDown = 22,
+	buttonPageLeft = 23
+	};
+
+// everything the decoder knows about the controls, updated in place by every report
+struct kontrolState
+	{
+	quint64 buttons; // bytes 1-8 of the 0x01 report, byte 1 in the lowest bits
+	quint8 knobs[8]; // encoder values of the 0xaa report
+	};
+
+// one edge: a button went down or up, or an encoder changed its value
+struct kontrolEvent
+	{
+	enum eventType { buttonDown, buttonUp, knobChange } type;
+	quint8 index; // bit number of the button or number of the encoder
+	quint8 value; // new encoder value
+	qint16 delta; // encoder change since the last report
+	};
+
+// turns raw input reports into state changes and edge events, without any heap allocation
+class hidDecoder
+{
+	public:
+		enum { maxEvents = 72 }; // 64 button edges and 8 encoders per report at most
+
+		hidDecoder();
+		int decode(const unsigned char *report, int length, kontrolEvent *events);
+		const kontrolState &state() const;
+		void reset();
+
+	private:
+		int decodeButtons(const unsigned char *report, kontrolEvent *events);
+		int decodeKnobs(const unsigned char *report, kontrolEvent *events);
+
+		kontrolState current;
+};
+
+#endif /*_HIDDECODER_H_*/
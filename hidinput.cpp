@@ -0,0 +1,101 @@
+#include <QDebug>
+#include "hidinput.h"
+
+hidInput::hidInput(QObject *parent) : QThread(parent)
+{
+	transport = NULL;
+	stopping.store(0);
+	notified.store(0);
+	overruns.store(0);
+	backlog.store(0);
+	peakBacklog.store(0);
+}
+
+// start reading from an opened device
+void hidInput::open(kontrolTransport *device)
+{
+	transport = device;
+	stopping.store(0);
+	start();
+}
+
+// stop the input thread, it notices the request at the latest after one read timeout
+void hidInput::close()
+{
+	stopping.store(1);
+	wait();
+	qDebug() << "input:" << peakBacklogDepth() << "reports peak backlog," << overrunCount() << "events lost";
+}
+
+// consumer side: fetch the next waiting event, returns false if there is none
+bool hidInput::read(kontrolEvent &event)
+{
+	// clear the flag before the ring is drained, so an event pushed meanwhile wakes the GUI again
+	notified.storeRelease(0);
+	return ring.pop(event);
+}
+
+quint64 hidInput::overrunCount() const
+{
+	return overruns.load();
+}
+
+// reports which were already waiting behind the first one at the last wakeup, and the maximum seen
+int hidInput::backlogDepth() const
+{
+	return backlog.load();
+}
+
+int hidInput::peakBacklogDepth() const
+{
+	return peakBacklog.load();
+}
+
+void hidInput::run()
+{
+	unsigned char report[91];
+	kontrolEvent events[hidDecoder::maxEvents];
+	decoder.reset();
+	while(!stopping.load())
+		{
+		// the timeout only bounds how long a stop request waits, an idle keyboard costs no CPU
+		int length = transport->readReport(report, sizeof(report), 250);
+		if(length < 0)
+			{
+			emit readFailed(); // most likely unplugged
+			break;
+			}
+		if(length == 0)
+			continue;
+
+		// take everything else which already waits in the HID queue before the GUI is woken
+		int waiting = 0;
+		while(length > 0)
+			{
+			const int count = decoder.decode(report, length, events);
+			for(int i=0;i<count;i++)
+				if(!ring.push(events[i]))
+					overruns++;
+			length = transport->readReport(report, sizeof(report), 0);
+			if(length > 0)
+				waiting++;
+			}
+		backlog.store(waiting);
+		if(waiting > peakBacklog.load())
+			peakBacklog.store(waiting);
+
+		if(notified.testAndSetOrdered(0, 1))
+			emit reportsAvailable();
+		if(length < 0)
+			{
+			emit readFailed();
+			break;
+			}
+		}
+}
+
+hidInput::~hidInput()
+{
+	if(isRunning())
+		close();
+}
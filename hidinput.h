@@ -0,0 +1,41 @@
+#ifndef _HIDINPUT_H_
+#define _HIDINPUT_H_
+
+#include <QAtomicInt>
+#include <QThread>
+#include "hiddecoder.h"
+#include "kontroltransport.h"
+#include "spscring.h"
+
+// input thread: blocks in readReport, drains every report waiting in the HID queue, decodes them
+// and hands the events to the GUI thread through a lock-free ring, the GUI is only woken when events are waiting
+class hidInput : public QThread
+{
+	Q_OBJECT
+
+	public:
+		explicit hidInput(QObject *parent = 0);
+		~hidInput();
+		void open(kontrolTransport *device);
+		void close();
+		bool read(kontrolEvent &event);
+		quint64 overrunCount() const;
+		int backlogDepth() const;
+		int peakBacklogDepth() const;
+
+	signals:
+		void reportsAvailable();
+		void readFailed();
+
+	protected:
+		void run();
+
+	private:
+		kontrolTransport *transport;
+		QAtomicInt stopping, notified, backlog, peakBacklog;
+		QAtomicInteger<quint64> overruns;
+		hidDecoder decoder;
+		spscRing<kontrolEvent, 1024> ring;
+};
+
+#endif /*_HIDINPUT_H_*/
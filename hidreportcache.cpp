@@ -0,0 +1,79 @@
+#include "hidreportcache.h"
+
+hidReportCache::hidReportCache()
+{
+	written = 0;
+	skipped = 0;
+}
+
+// send the report stored under this name unless the device already got exactly these bytes,
+// returns the writeReport result or 0 for a skipped report
+int hidReportCache::write(kontrolTransport *transport, const QString &name, const QByteArray &report)
+{
+	cachedReport &cached = entry(name);
+	if(cached.sent && (cached.data == report))
+		{
+		skipped++;
+		return 0;
+		}
+
+	int res = transport->writeReport(reinterpret_cast<const unsigned char *>(report.constData()), report.count());
+	cached.data = report;
+	cached.sent = (res >= 0); // unknown what the device got after an error, send it again next time
+	written++;
+	return res;
+}
+
+// store a report without sending it (no device connected), the next replay() delivers it
+void hidReportCache::remember(const QString &name, const QByteArray &report)
+{
+	cachedReport &cached = entry(name);
+	cached.data = report;
+	cached.sent = false;
+}
+
+// write every cached report again in its original order, e.g. to a device which was reconnected
+// and lost its state. returns the number of reports which failed
+int hidReportCache::replay(kontrolTransport *transport)
+{
+	int failed = 0;
+	for(int i=0;i<reports.count();i++)
+		{
+		int res = transport->writeReport(reinterpret_cast<const unsigned char *>(reports[i].data.constData()), reports[i].data.count());
+		reports[i].sent = (res >= 0);
+		if(res < 0)
+			failed++;
+		written++;
+		}
+	return failed;
+}
+
+// forget what the device got, e.g. when its state is unknown. the reports themselves are kept for replay()
+void hidReportCache::invalidate()
+{
+	for(int i=0;i<reports.count();i++)
+		reports[i].sent = false;
+}
+
+hidReportCache::cachedReport &hidReportCache::entry(const QString &name)
+{
+	// only a handful of named reports exist, a linear search keeps their order
+	for(int i=0;i<reports.count();i++)
+		if(reports[i].name == name)
+			return reports[i];
+	cachedReport cached;
+	cached.name = name;
+	cached.sent = false;
+	reports.append(cached);
+	return reports.last();
+}
+
+quint64 hidReportCache::writtenCount() const
+{
+	return written;
+}
+
+quint64 hidReportCache::skippedCount() const
+{
+	return skipped;
+}
@@ -0,0 +1,37 @@
+#ifndef _HIDREPORTCACHE_H_
+#define _HIDREPORTCACHE_H_
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include "kontroltransport.h"
+
+// last copy of every HID output report, a report whose bytes the device already got is not written again.
+// the copies are kept in the order the reports were first written, so the whole state can be replayed
+// to a reconnected device the same way it was built up
+class hidReportCache
+{
+	public:
+		hidReportCache();
+		int write(kontrolTransport *transport, const QString &name, const QByteArray &report);
+		void remember(const QString &name, const QByteArray &report);
+		int replay(kontrolTransport *transport);
+		void invalidate();
+		quint64 writtenCount() const;
+		quint64 skippedCount() const;
+
+	private:
+		struct cachedReport
+			{
+			QString name;
+			QByteArray data;
+			bool sent; // false if the device may not have these bytes
+			};
+
+		cachedReport &entry(const QString &name);
+
+		QList<cachedReport> reports;
+		quint64 written, skipped;
+};
+
+#endif /*_HIDREPORTCACHE_H_*/
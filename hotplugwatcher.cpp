@@ -0,0 +1,64 @@
+#include <QDebug>
+#include "hotplugwatcher.h"
+
+hotplugWatcher::hotplugWatcher(QObject *parent) : QThread(parent)
+{
+	ctx = NULL;
+	callback = 0;
+	stopping.store(0);
+}
+
+// watch for devices of the vendor (0x17cc = Native Instruments), false if hotplug events are not available
+bool hotplugWatcher::open(int vendorId)
+{
+	if(ctx)
+		return true;
+	if(libusb_init(&ctx) < 0)
+		{
+		ctx = NULL;
+		return false;
+		}
+	if(!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG) || (libusb_hotplug_register_callback(ctx, libusb_hotplug_event(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT), libusb_hotplug_flag(0), vendorId, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, event, this, &callback) != LIBUSB_SUCCESS))
+		{
+		qDebug() << "hotplug: not supported, polling for keyboards";
+		libusb_exit(ctx);
+		ctx = NULL;
+		return false;
+		}
+	stopping.store(0);
+	start();
+	return true;
+}
+
+// removing the callback wakes the event thread, the timeout in run() covers libusb versions which don't
+void hotplugWatcher::close()
+{
+	if(!ctx)
+		return;
+	stopping.store(1);
+	libusb_hotplug_deregister_callback(ctx, callback);
+	wait();
+	libusb_exit(ctx);
+	ctx = NULL;
+}
+
+void hotplugWatcher::run()
+{
+	while(!stopping.load())
+		{
+		timeval timeout = { 1, 0 };
+		libusb_handle_events_timeout_completed(ctx, &timeout, NULL);
+		}
+}
+
+// called by libusb on the event thread, the connected slots run on the GUI thread
+int LIBUSB_CALL hotplugWatcher::event(libusb_context *, libusb_device *, libusb_hotplug_event, void *watcher)
+{
+	emit static_cast<hotplugWatcher *>(watcher)->changed();
+	return 0; // stay registered
+}
+
+hotplugWatcher::~hotplugWatcher()
+{
+	close();
+}
@@ -0,0 +1,35 @@
+#ifndef _HOTPLUGWATCHER_H_
+#define _HOTPLUGWATCHER_H_
+
+#include <QAtomicInt>
+#include <QThread>
+#include "usbtransport.h"
+
+// hotplug thread: sleeps in libusb until a device of the vendor is plugged in or out and emits changed(),
+// so the device list is only enumerated when something happened. open() fails where libusb can't report
+// hotplug events, the caller has to poll then
+class hotplugWatcher : public QThread
+{
+	Q_OBJECT
+
+	public:
+		explicit hotplugWatcher(QObject *parent = 0);
+		~hotplugWatcher();
+		bool open(int vendorId);
+		void close();
+
+	signals:
+		void changed();
+
+	protected:
+		void run();
+
+	private:
+		static int LIBUSB_CALL event(libusb_context *context, libusb_device *device, libusb_hotplug_event type, void *watcher);
+
+		libusb_context *ctx;
+		libusb_hotplug_callback_handle callback;
+		QAtomicInt stopping;
+};
+
+#endif /*_HOTPLUGWATCHER_H_*/
@@ -0,0 +1,67 @@
+#include "imagecache.h"
+
+imageCache::imageCache(int megabytes, QObject *parent) : QObject(parent)
+{
+	hits = 0;
+	misses = 0;
+	setCapacity(megabytes);
+	connect(&watcher, SIGNAL(fileChanged(const QString &)), this, SLOT(fileChanged(const QString &)));
+}
+
+void imageCache::setCapacity(int megabytes)
+{
+	images.setMaxCost(qMax(1, megabytes)*1024);
+}
+
+// in megabytes
+int imageCache::capacity() const
+{
+	return images.maxCost()/1024;
+}
+
+// the picture in file scaled to size, a null image if it can't be read. Format_Invalid keeps the
+// decoded format at full depth. repeated calls for an unchanged file return the same (implicitly
+// shared) image without any disk access
+QImage imageCache::scaled(const QString &file, const QSize &size, QImage::Format format)
+{
+	if(file.isEmpty())
+		return QImage();
+	QString key = file+"|"+QString::number(size.width())+"x"+QString::number(size.height())+"|"+QString::number(format);
+	QImage *cached = images.object(key);
+	if(cached)
+		{
+		hits++;
+		return *cached;
+		}
+
+	misses++;
+	QImage picture = QImage(file).scaled(size);
+	if(format != QImage::Format_Invalid)
+		picture = picture.convertToFormat(format);
+	if(picture.isNull())
+		return picture;
+	// watched from now on, an editor which replaces the file ends the watch and the next miss renews it
+	if(!watcher.files().contains(file))
+		watcher.addPath(file);
+	images.insert(key, new QImage(picture), qMax(1, picture.byteCount()/1024));
+	return picture;
+}
+
+// the file was written, replaced or removed: all sizes and formats of it are decoded again on their next use
+void imageCache::fileChanged(const QString &file)
+{
+	QList<QString> keys = images.keys();
+	for(int i=0;i<keys.count();i++)
+		if(keys[i].startsWith(file+"|"))
+			images.remove(keys[i]);
+}
+
+quint64 imageCache::hitCount() const
+{
+	return hits;
+}
+
+quint64 imageCache::missCount() const
+{
+	return misses;
+}
@@ -0,0 +1,37 @@
+#ifndef _IMAGECACHE_H_
+#define _IMAGECACHE_H_
+
+#include <QtGlobal>
+#include <QCache>
+#include <QFileSystemWatcher>
+#include <QImage>
+#include <QObject>
+#include <QSize>
+#include <QString>
+
+// decoded pictures, scaled and by default converted to the RGB565 format of the screens. an entry
+// is found by path, target size and format without touching the disk, a file system watcher drops
+// the entries of a file when it is edited so it is read again. the least recently used entries are
+// dropped when the memory limit is reached
+class imageCache : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit imageCache(int megabytes = 16, QObject *parent = 0);
+		void setCapacity(int megabytes);
+		int capacity() const;
+		QImage scaled(const QString &file, const QSize &size, QImage::Format format = QImage::Format_RGB16);
+		quint64 hitCount() const;
+		quint64 missCount() const;
+
+	private slots:
+		void fileChanged(const QString &file);
+
+	private:
+		QCache<QString, QImage> images; // costs in kilobytes
+		QFileSystemWatcher watcher;
+		quint64 hits, misses;
+};
+
+#endif /*_IMAGECACHE_H_*/
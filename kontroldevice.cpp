@@ -0,0 +1,256 @@
+#include <QDebug>
+#include <QMutexLocker>
+#include <QtConcurrentRun>
+#include "displayencoder.h"
+#include "usbtransport.h"
+#include "kontroldevice.h"
+
+// takes ownership of the transport
+kontrolDevice::kontrolDevice(kontrolTransport *device, QObject *parent) : QObject(parent)
+{
+	transport = device;
+	attached = false;
+	unchangedTotal = 0;
+	repeatedTotal = 0;
+	framesDrawn = 0;
+	unchangedBytes = 0;
+	repeatedBytes = 0;
+	output.setMaxThreadCount(1); // one thread keeps the reports in the order they were handed over
+	connect(&input, SIGNAL(reportsAvailable()), this, SIGNAL(eventsAvailable()));
+	connect(&input, SIGNAL(readFailed()), this, SIGNAL(lost()));
+	connect(&display, SIGNAL(transferFailed(int)), this, SLOT(transferFailed(int)));
+	connect(&display, SIGNAL(recovered()), this, SLOT(transferRecovered()));
+	connect(&display, SIGNAL(statisticsUpdated(double, double, double)), this, SLOT(publishStatistics(double, double, double)));
+	connect(&display, SIGNAL(frameSent(quint64, int)), this, SIGNAL(frameSent(quint64, int)));
+}
+
+// open the keyboard, start its threads and send it the complete last known state in one batch:
+// all HID output reports in their original order and both screens from the shadow buffers
+bool kontrolDevice::attach()
+{
+	if(attached)
+		return true;
+	QMutexLocker locker(&reportLock);
+	if(!transport->open())
+		return false;
+	attached = true;
+
+	input.open(transport);
+	if(!display.open(transport))
+		qDebug() << "the displays could not be opened";
+
+	int failed = reports.replay(transport);
+	if(failed)
+		qDebug() << "device:" << failed << "HID reports could not be restored";
+	for(uint8_t screen=0;screen<2;screen++)
+		if(shadow[screen].isValid())
+			queueFrame(screen, shadow[screen].image(), shadow[screen].image().rect(), 0, 0, 0);
+	return true;
+}
+
+// stop the threads and close the keyboard, the cached state is kept for the next attach()
+void kontrolDevice::detach()
+{
+	if(!attached)
+		return;
+	QMutexLocker locker(&reportLock); // a write of the output thread finishes first
+	input.close();
+	qDebug() << label << "output:" << reports.writtenCount() << "HID reports written," << reports.skippedCount() << "unchanged ones skipped," << unchangedTotal << "display bytes saved by the shadow buffers," << repeatedTotal << "by repeat blocks";
+	display.close();
+	transport->close();
+	reports.invalidate();
+	attached = false;
+}
+
+bool kontrolDevice::isAttached() const
+{
+	return attached;
+}
+
+// model and serial number as shown in the UI
+QString kontrolDevice::name() const
+{
+	return label;
+}
+
+void kontrolDevice::setName(const QString &name)
+{
+	label = name;
+}
+
+// 49, 61 or 88 by the model, 0 if it is not known
+int kontrolDevice::keyCount() const
+{
+	return usbTransport::keyCount(transport->productId());
+}
+
+// send a named HID output report, unchanged reports are skipped. without a keyboard
+// the report is only stored and sent on the next attach()
+int kontrolDevice::writeReport(const QString &name, const QByteArray &report)
+{
+	QMutexLocker locker(&reportLock);
+	if(!attached)
+		{
+		reports.remember(name, report);
+		return 0;
+		}
+	return reports.write(transport, name, report);
+}
+
+// write reports one after another on the output thread of this device, the future holds
+// the writeReport() result of every report
+QFuture<QList<int> > kontrolDevice::writeReports(const QList<QPair<QString,QByteArray> > &reports)
+{
+	return QtConcurrent::run(&output, this, &kontrolDevice::writeAll, reports);
+}
+
+QList<int> kontrolDevice::writeAll(const QList<QPair<QString,QByteArray> > &reports)
+{
+	QList<int> results;
+	for(int i=0;i<reports.count();i++)
+		results.append(writeReport(reports[i].first, reports[i].second));
+	return results;
+}
+
+// show an RGB565 frame at x/y of a screen, only the rectangles which differ from the shadow buffer are sent.
+// returns the ids frameSent() reports for them, without a keyboard only the shadow buffer is updated.
+// the transfer thread sends frames of a higher priority first
+QList<quint64> kontrolDevice::drawFrame(uint8_t screen, const QImage &frame, int x, int y, int priority)
+{
+	// compare with what the screen already shows and only send the changed rectangles
+	QList<QRect> dirty = shadow[screen].update(frame, x, y);
+	QList<quint64> ids;
+	if(!attached)
+		return ids;
+	int changed = 0, sent = 0;
+	for(const QRect &rect : dirty)
+		{
+		int size = queueFrame(screen, frame, rect, x, y, priority, &ids);
+		if(size <= 0)
+			continue;
+		changed += displayEncoder::frameSize(rect.width(), rect.height());
+		sent += size;
+		}
+
+	// the savings of this frame against a complete transmission, split by where they come from
+	int unchanged = displayEncoder::frameSize(frame.width(), frame.height()) - changed;
+	int repeated = changed - sent;
+	framesDrawn++;
+	unchangedBytes += qMax(0, unchanged);
+	repeatedBytes += qMax(0, repeated);
+	unchangedTotal += qMax(0, unchanged);
+	repeatedTotal += qMax(0, repeated);
+	return ids;
+}
+
+// the measurements of the display thread together with the average savings of the frames drawn since the last ones
+void kontrolDevice::publishStatistics(double megabytesPerSecond, double leftFramesPerSecond, double rightFramesPerSecond)
+{
+	double unchanged = framesDrawn ? double(unchangedBytes)/framesDrawn : 0;
+	double repeated = framesDrawn ? double(repeatedBytes)/framesDrawn : 0;
+	framesDrawn = 0;
+	unchangedBytes = 0;
+	repeatedBytes = 0;
+	emit displayStatistics(megabytesPerSecond, leftFramesPerSecond, rightFramesPerSecond, unchanged, repeated);
+}
+
+// show several small RGB565 images of a screen with one transfer: their display commands are sent back to back.
+// they are sent as they are, without comparing them with the shadow buffer (which is still kept up to date).
+// the transfer replaces a waiting one of the same screen with the same bounding rectangle, so the tiles of one
+// place should always be drawn together. returns the id frameSent() reports, 0 if nothing was queued
+quint64 kontrolDevice::drawTiles(uint8_t screen, const QList<QImage> &tiles, const QList<QPoint> &positions, int priority)
+{
+	QRect bounds;
+	int worst = 0;
+	for(int i=0;i<tiles.count();i++)
+		{
+		shadow[screen].update(tiles[i], positions[i].x(), positions[i].y());
+		bounds |= QRect(positions[i], tiles[i].size());
+		worst += displayEncoder::frameSize(tiles[i].width(), tiles[i].height());
+		}
+	if(!attached || tiles.isEmpty())
+		return 0;
+
+	QByteArray tux(worst, Qt::Uninitialized);
+	int size = 0;
+	for(int i=0;i<tiles.count();i++)
+		{
+		int encoded = displayEncoder::encode(reinterpret_cast<uchar *>(tux.data())+size, screen, tiles[i], positions[i].x(), positions[i].y());
+		if(encoded < 0)
+			{
+			qDebug() << label << "screen" << screen << ": cannot send a tile of" << tiles[i].size() << "with an odd number of pixels";
+			continue;
+			}
+		size += encoded;
+		}
+	if(size == 0)
+		return 0;
+	tux.resize(size);
+
+	framesDrawn++;
+	repeatedBytes += worst-size;
+	repeatedTotal += worst-size;
+	return display.queue(screen, bounds.x(), bounds.y(), bounds.width(), bounds.height(), tux, priority);
+}
+
+// encode the screen rectangle rect (frame is placed at x/y) and hand it to the transfer thread,
+// returns the size of the display command and adds its id to ids
+int kontrolDevice::queueFrame(uint8_t screen, const QImage &frame, const QRect &rect, int x, int y, int priority, QList<quint64> *ids)
+{
+	// one sized buffer per transfer, it is handed over to the transfer thread
+	// (sized for the worst case, solid areas become repeat blocks and shrink it)
+	QByteArray tux(displayEncoder::frameSize(rect.width(), rect.height()), Qt::Uninitialized);
+	int size = displayEncoder::encode(reinterpret_cast<uchar *>(tux.data()), screen, frame, rect.x(), rect.y(), rect.translated(-x, -y));
+	if(size < 0)
+		{
+		qDebug() << label << "screen" << screen << ": cannot send" << rect << "with an odd number of pixels";
+		return 0;
+		}
+	tux.resize(size);
+
+	// the transfer thread sends the frame, a newer frame for the same rectangle replaces it while it waits
+	quint64 id = display.queue(screen, rect.x(), rect.y(), rect.width(), rect.height(), tux, priority);
+	if(ids)
+		ids->append(id);
+	return tux.count();
+}
+
+// fetch the next input event, false if there is none
+bool kontrolDevice::readEvent(kontrolEvent &event)
+{
+	return input.read(event);
+}
+
+void kontrolDevice::transferFailed(int error)
+{
+	// unplugged: the shadow buffers keep what the screens should show, attach() sends it again
+	if(error == LIBUSB_ERROR_NO_DEVICE)
+		{
+		emit lost();
+		return;
+		}
+	// the screens may not show what the shadow buffers contain anymore
+	shadow[0].invalidate();
+	shadow[1].invalidate();
+	emit displayError(error);
+}
+
+// the display works again after being degraded: frames may have been lost meanwhile,
+// so both screens are sent completely from the shadow buffers
+void kontrolDevice::transferRecovered()
+{
+	for(uint8_t screen=0;screen<2;screen++)
+		{
+		QImage frame = shadow[screen].image().copy();
+		shadow[screen].invalidate();
+		drawFrame(screen, frame);
+		}
+	emit displayRecovered();
+}
+
+kontrolDevice::~kontrolDevice()
+{
+	output.waitForDone();
+	detach();
+	delete transport;
+}
@@ -0,0 +1,75 @@
+#ifndef _KONTROLDEVICE_H_
+#define _KONTROLDEVICE_H_
+
+#include <QtGlobal>
+#include <QFuture>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QPoint>
+#include <QString>
+#include <QThreadPool>
+#include "hidinput.h"
+#include "hidreportcache.h"
+#include "kontroldisplay.h"
+#include "kontroltransport.h"
+#include "shadowframebuffer.h"
+
+// one keyboard with all its I/O state (several keyboards can be driven at once): input thread,
+// output thread, display session, the last HID output reports and the pixels of both screens.
+// the state outlives a disconnect, so everything can be replayed when the keyboard comes back
+class kontrolDevice : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit kontrolDevice(kontrolTransport *device, QObject *parent = 0);
+		~kontrolDevice();
+		bool attach();
+		void detach();
+		bool isAttached() const;
+		QString name() const;
+		void setName(const QString &name);
+		int keyCount() const;
+		int writeReport(const QString &name, const QByteArray &report);
+		QFuture<QList<int> > writeReports(const QList<QPair<QString,QByteArray> > &reports);
+		QList<quint64> drawFrame(uint8_t screen, const QImage &frame, int x = 0, int y = 0, int priority = 0);
+		quint64 drawTiles(uint8_t screen, const QList<QImage> &tiles, const QList<QPoint> &positions, int priority = 0);
+		bool readEvent(kontrolEvent &event);
+
+	signals:
+		void eventsAvailable();
+		void lost();
+		void displayError(int error);
+		void displayRecovered();
+		void displayStatistics(double megabytesPerSecond, double leftFramesPerSecond, double rightFramesPerSecond, double unchangedBytesPerFrame, double repeatedBytesPerFrame);
+		void frameSent(quint64 id, int result);
+
+	private slots:
+		void transferFailed(int error);
+		void transferRecovered();
+		void publishStatistics(double megabytesPerSecond, double leftFramesPerSecond, double rightFramesPerSecond);
+
+	private:
+		int queueFrame(uint8_t screen, const QImage &frame, const QRect &rect, int x, int y, int priority, QList<quint64> *ids = 0);
+		QList<int> writeAll(const QList<QPair<QString,QByteArray> > &reports);
+
+		kontrolTransport *transport;
+		bool attached;
+		QString label;
+		hidInput input;
+		kontrolDisplay display;
+		hidReportCache reports;
+		QMutex reportLock; // reports are written by the GUI and the output thread
+		QThreadPool output;
+		shadowFramebuffer shadow[2];
+		// bytes a complete transmission of the drawn frames would have taken more, left out because the shadow
+		// buffers found them unchanged or because the encoder sent them as repeat blocks. the totals are
+		// logged by detach(), the others are reset with every published statistics
+		quint64 unchangedTotal, repeatedTotal;
+		quint64 framesDrawn, unchangedBytes, repeatedBytes;
+};
+
+#endif /*_KONTROLDEVICE_H_*/
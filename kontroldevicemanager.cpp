@@ -0,0 +1,157 @@
+#include <QDebug>
+#include "mocktransport.h"
+#include "kontroldevicemanager.h"
+
+// QKONTROL_MOCK=<script> runs against a single scripted stand-in device instead of the keyboards
+kontrolDeviceManager::kontrolDeviceManager(QObject *parent) : QObject(parent)
+{
+	mock = qEnvironmentVariableIsSet("QKONTROL_MOCK");
+	settling = 0;
+
+	// the HID interface of a keyboard shows up a moment after the USB device, a hotplug event is followed
+	// by a few scans 250 ms apart. without hotplug events they keep the time until a plugged in keyboard
+	// works well under a second
+	timer.setInterval(250);
+	connect(&timer, SIGNAL(timeout()), this, SLOT(poll()));
+	connect(&hotplug, SIGNAL(changed()), this, SLOT(devicesChanged()));
+}
+
+// attach the keyboards which are already connected and watch for changes from now on
+void kontrolDeviceManager::start()
+{
+	scan();
+	if(!mock && !hotplug.open(0x17cc)) // vendor ID 0x17cc = Native Instruments
+		timer.start();
+}
+
+void kontrolDeviceManager::stop()
+{
+	hotplug.close();
+	timer.stop();
+	for(kontrolDevice *device : devices)
+		detach(device);
+}
+
+// every keyboard seen since start(), attached or not: the cached state of each can always be written
+QList<kontrolDevice *> kontrolDeviceManager::deviceList() const
+{
+	return devices;
+}
+
+void kontrolDeviceManager::scan()
+{
+	if(mock)
+		{
+		if(devices.isEmpty())
+			addDevice("mock", new mockTransport(QString::fromLocal8Bit(qgetenv("QKONTROL_MOCK")), QString::fromLocal8Bit(qgetenv("QKONTROL_MOCK_RECORD"))), "mock keyboard");
+		attach(devices.first());
+		return;
+		}
+
+	QMap<QString,foundDevice> present = presentDevices();
+	for(QMap<QString,foundDevice>::const_iterator i = present.constBegin(); i != present.constEnd(); ++i)
+		{
+		kontrolDevice *device = known.value(i.key());
+		if(!device)
+			{
+			transports[i.key()] = new usbTransport(i->path, i->productId);
+			device = addDevice(i.key(), transports[i.key()], i->name);
+			}
+		if(!device->isAttached())
+			{
+			transports[i.key()]->setPath(i->path, i->productId);
+			attach(device);
+			}
+		}
+	for(QMap<QString,kontrolDevice *>::const_iterator i = known.constBegin(); i != known.constEnd(); ++i)
+		if(!present.contains(i.key()))
+			detach(i.value());
+}
+
+void kontrolDeviceManager::poll()
+{
+	scan();
+	if(hotplug.isRunning() && (--settling <= 0))
+		timer.stop();
+}
+
+// a device of the vendor was plugged in or out
+void kontrolDeviceManager::devicesChanged()
+{
+	scan();
+	settling = 8;
+	timer.start();
+}
+
+// a read or transfer error: close the device right away, the following scans attach it
+// again if it is still (or again) there
+void kontrolDeviceManager::deviceLost()
+{
+	kontrolDevice *device = qobject_cast<kontrolDevice *>(sender());
+	if(device)
+		detach(device);
+	if(!mock)
+		{
+		settling = 8;
+		timer.start();
+		}
+}
+
+kontrolDevice *kontrolDeviceManager::addDevice(const QString &key, kontrolTransport *transport, const QString &name)
+{
+	kontrolDevice *device = new kontrolDevice(transport, this);
+	device->setName(name);
+	connect(device, SIGNAL(lost()), this, SLOT(deviceLost()));
+	devices.append(device);
+	known[key] = device;
+	emit deviceAdded(device);
+	return device;
+}
+
+void kontrolDeviceManager::attach(kontrolDevice *device)
+{
+	if(device->isAttached() || !device->attach())
+		return;
+	qDebug() << "device:" << device->name() << "attached";
+	emit deviceAttached(device);
+}
+
+void kontrolDeviceManager::detach(kontrolDevice *device)
+{
+	if(!device->isAttached())
+		return;
+	device->detach();
+	qDebug() << "device:" << device->name() << "detached";
+	emit deviceDetached(device);
+}
+
+// all supported keyboards without opening them. a keyboard can be listed once per HID interface,
+// the first entry wins like in hid_open()
+QMap<QString,kontrolDeviceManager::foundDevice> kontrolDeviceManager::presentDevices() const
+{
+	QMap<QString,foundDevice> present;
+	hid_device_info *list = hid_enumerate(0x17cc, 0); // vendor ID 0x17cc = Native Instruments
+	for(hid_device_info *d = list; d; d = d->next)
+		{
+		if(!usbTransport::isSupported(d->product_id))
+			continue;
+		QString serial = d->serial_number ? QString::fromWCharArray(d->serial_number) : QString();
+		QString key = serial.isEmpty() ? QString::fromLocal8Bit(d->path) : serial;
+		if(present.contains(key))
+			continue;
+		foundDevice found;
+		found.path = QString::fromLocal8Bit(d->path);
+		found.productId = d->product_id;
+		found.name = d->product_string ? QString::fromWCharArray(d->product_string) : QString("Komplete Kontrol");
+		if(!serial.isEmpty())
+			found.name += " ("+serial+")";
+		present[key] = found;
+		}
+	hid_free_enumeration(list);
+	return present;
+}
+
+kontrolDeviceManager::~kontrolDeviceManager()
+{
+	stop();
+}
@@ -0,0 +1,61 @@
+#ifndef _KONTROLDEVICEMANAGER_H_
+#define _KONTROLDEVICEMANAGER_H_
+
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include "hotplugwatcher.h"
+#include "kontroldevice.h"
+#include "usbtransport.h"
+
+// watches for keyboards to be plugged in and out: every connected keyboard gets its own
+// kontrolDevice as soon as it shows up and is detached when it is gone, a reconnected
+// keyboard is recognized by its serial number and gets its last state back. the keyboards
+// are only enumerated after a hotplug event, without hotplug support they are polled
+class kontrolDeviceManager : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit kontrolDeviceManager(QObject *parent = 0);
+		~kontrolDeviceManager();
+		void start();
+		void stop();
+		QList<kontrolDevice *> deviceList() const;
+
+	signals:
+		void deviceAdded(kontrolDevice *device);
+		void deviceAttached(kontrolDevice *device);
+		void deviceDetached(kontrolDevice *device);
+
+	private slots:
+		void scan();
+		void poll();
+		void devicesChanged();
+		void deviceLost();
+
+	private:
+		// a supported keyboard found by hid_enumerate()
+		struct foundDevice
+			{
+			QString path, name;
+			int productId;
+			};
+
+		kontrolDevice *addDevice(const QString &key, kontrolTransport *transport, const QString &name);
+		void attach(kontrolDevice *device);
+		void detach(kontrolDevice *device);
+		QMap<QString,foundDevice> presentDevices() const;
+
+		QList<kontrolDevice *> devices; // in the order they were found, never removed
+		QMap<QString,kontrolDevice *> known; // by serial number (or HID path)
+		QMap<QString,usbTransport *> transports;
+		bool mock;
+		hotplugWatcher hotplug;
+		QTimer timer;
+		int settling; // scans left after a hotplug event
+};
+
+#endif /*_KONTROLDEVICEMANAGER_H_*/
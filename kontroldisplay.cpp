@@ -0,0 +1,376 @@
+#include <QDebug>
+#include <QMutexLocker>
+#include "usbtransport.h"
+#include "kontroldisplay.h"
+
+// a failing transfer is retried after 20 ms, the pause doubles up to one second
+static const int minimumBackoff = 20;
+static const int maximumBackoff = 1000;
+
+// frames of this size count as complete screens in the statistics
+static const int screenWidth = 480;
+static const int screenHeight = 272;
+
+// QKONTROL_USB_TIMEOUT=<milliseconds> changes the default timeout of one transfer
+kontrolDisplay::kontrolDisplay(QObject *parent) : QThread(parent)
+{
+	transport = NULL;
+	stopping = false;
+	lastId = 0;
+	timeout = 1000;
+	retries = 3;
+	if(qEnvironmentVariableIsSet("QKONTROL_USB_TIMEOUT"))
+		timeout = qgetenv("QKONTROL_USB_TIMEOUT").toInt();
+	frames.store(0);
+	dropped.store(0);
+	failures.store(0);
+	degraded.store(0);
+	bytes.store(0);
+	fullFrames[0].store(0);
+	fullFrames[1].store(0);
+}
+
+// claim the display interface of the device and start the transfer thread
+bool kontrolDisplay::open(kontrolTransport *device)
+{
+	transport = device;
+	bool attached = transport->attachDisplay();
+	frames.store(0);
+	dropped.store(0);
+	failures.store(0);
+	degraded.store(0);
+	bytes.store(0);
+	fullFrames[0].store(0);
+	fullFrames[1].store(0);
+	publishedBytes = 0;
+	publishedFrames[0] = publishedFrames[1] = 0;
+	busy = 0;
+	clock.start();
+	statistics.start();
+	stopping = false;
+	start();
+	return attached;
+}
+
+// stop the transfer thread after the frame in flight and release the device
+void kontrolDisplay::close()
+{
+	if(isRunning())
+		{
+		lock.lock();
+		stopping = true;
+		QList<pendingFrame> unsent = pending;
+		pending.clear();
+		wakeup.wakeOne();
+		stopped.wakeAll();
+		lock.unlock();
+		wait();
+		for(const pendingFrame &f : unsent)
+			emit frameSent(f.id, LIBUSB_ERROR_INTERRUPTED);
+		}
+	if(frames.load() > 0)
+		qDebug() << "display:" << frames.load() << "frames," << dropped.load() << "dropped," << failures.load() << "failed transfers," << bytes.load() << "bytes," << framesPerSecond() << "fps";
+	if(transport)
+		{
+		transport->flushDisplay(); // streamed chunks of the last frame
+		transport->detachDisplay();
+		}
+	transport = NULL;
+}
+
+// hand a complete display command (header, pixel blocks and trailer) to the transfer thread,
+// an older frame for the same screen and rectangle which was not sent yet is replaced (and
+// reported as sent, its successor carries the newer pixels). frames with a higher priority overtake waiting
+// ones they don't overlap (e.g. knob values a background repaint). returns the id frameSent() reports
+quint64 kontrolDisplay::queue(uint8_t screen, ushort x, ushort y, ushort width, ushort height, const QByteArray &frame, int priority)
+{
+	QMutexLocker locker(&lock);
+	pendingFrame f;
+	f.id = ++lastId;
+	f.priority = priority;
+	f.attempts = 0;
+	f.screen = screen;
+	f.x = x;
+	f.y = y;
+	f.width = width;
+	f.height = height;
+	f.data = frame;
+	for(int i=0;i<pending.count();i++)
+		if((pending[i].screen == screen) && (pending[i].x == x) && (pending[i].y == y) && (pending[i].width == width) && (pending[i].height == height))
+			{
+			quint64 replaced = pending[i].id;
+			dropped++;
+			// the old place in the queue is only kept if no later frame overlaps it,
+			// otherwise the new pixels would be sent first and painted over
+			bool later = false;
+			for(int j=i+1;(j<pending.count()) && !later;j++)
+				later = overlaps(pending[j], f);
+			if(later)
+				{
+				pending.removeAt(i);
+				pending.append(f);
+				wakeup.wakeOne();
+				}
+			else
+				pending[i] = f;
+			locker.unlock();
+			emit frameSent(replaced, 0);
+			return f.id;
+			}
+	pending.append(f);
+	wakeup.wakeOne();
+	return f.id;
+}
+
+// both frames change pixels of the same screen area
+bool kontrolDisplay::overlaps(const pendingFrame &a, const pendingFrame &b)
+{
+	return (a.screen == b.screen) && QRect(a.x, a.y, a.width, a.height).intersects(QRect(b.x, b.y, b.width, b.height));
+}
+
+// frame a paints over all of frame b
+bool kontrolDisplay::covers(const pendingFrame &a, const pendingFrame &b)
+{
+	return (a.screen == b.screen) && QRect(a.x, a.y, a.width, a.height).contains(QRect(b.x, b.y, b.width, b.height));
+}
+
+// timeout 0 lets a transfer wait forever, retries is the number of extra attempts before a frame is given up
+void kontrolDisplay::setTransferPolicy(int timeout, int retries)
+{
+	QMutexLocker locker(&lock);
+	this->timeout = qMax(0, timeout);
+	this->retries = qMax(0, retries);
+}
+
+// true after a frame could not be sent, until the next transfer succeeds
+bool kontrolDisplay::isDegraded() const
+{
+	return degraded.load() != 0;
+}
+
+quint64 kontrolDisplay::failureCount() const
+{
+	return failures.load();
+}
+
+// transfer thread: the lock is only held to take the next frame, never during a transfer. a streaming transport
+// takes the next frame while the last ones are still in flight, their results are collected on the way
+void kontrolDisplay::run()
+{
+	int backoff = 0; // pause before the next attempt while transfers fail, 0 while they work
+	forever
+		{
+		backoff = collect(false, backoff);
+		lock.lock();
+		if(pending.isEmpty() && !stopping && !inFlight.isEmpty())
+			{
+			// out of frames: let the transport finish what it still streams before sleeping
+			lock.unlock();
+			backoff = collect(true, backoff);
+			lock.lock();
+			}
+		while(pending.isEmpty() && !stopping)
+			wakeup.wait(&lock);
+		if(stopping)
+			{
+			lock.unlock();
+			collect(true, backoff);
+			return;
+			}
+		int next = 0;
+		for(int i=1;i<pending.count();i++)
+			if(pending[i].priority > pending[next].priority)
+				next = i;
+		// overtaking must not change what the screen shows in the end: older frames the chosen one paints
+		// over completely are dropped, if it only partly overlaps one the oldest of them goes first
+		QList<quint64> covered;
+		for(int i=0;i<next;)
+			{
+			if(!overlaps(pending[i], pending[next]))
+				i++;
+			else if(covers(pending[next], pending[i]))
+				{
+				covered.append(pending.takeAt(i).id);
+				dropped++;
+				next--;
+				}
+			else
+				{
+				next = i;
+				i = 0;
+				}
+			}
+		pendingFrame frame = pending.takeAt(next);
+		int frameTimeout = timeout; // setTransferPolicy() may change it meanwhile
+		lock.unlock();
+		for(quint64 id : covered)
+			emit frameSent(id, 0);
+
+		// a degraded display is not hammered, every frame waits for the backoff first
+		if(backoff && !pause(backoff))
+			{
+			emit frameSent(frame.id, LIBUSB_ERROR_INTERRUPTED);
+			collect(true, backoff);
+			return;
+			}
+		int r = write(frame, frameTimeout);
+		if(r > 0)
+			continue; // in flight, collect() reports it
+		QList<pendingFrame> again;
+		backoff = complete(frame, r, backoff, again);
+		requeue(again);
+		}
+}
+
+// the frames the transport finished since the last call; with wait all of them, the transport is flushed first
+int kontrolDisplay::collect(bool wait, int backoff)
+{
+	if(inFlight.isEmpty())
+		return backoff;
+	QElapsedTimer transfer;
+	transfer.start();
+	if(wait)
+		transport->flushDisplay();
+	QList<displayResult> results = transport->displayResults();
+	busy += transfer.nsecsElapsed();
+
+	// in the order they were written, so frames which go back to the queue keep it
+	QList<pendingFrame> again;
+	for(int i=0;i<inFlight.count();)
+		{
+		int result = 1;
+		for(const displayResult &done : results)
+			if(done.tag == inFlight[i].id)
+				result = done.result;
+		if(wait && (result > 0))
+			result = LIBUSB_ERROR_INTERRUPTED; // dropped by the transport with the device handle, sent again
+		if(result > 0)
+			i++;
+		else
+			backoff = complete(inFlight.takeAt(i), result, backoff, again);
+		}
+	requeue(again);
+	publish();
+	return backoff;
+}
+
+// the result of a written frame: sent, to be retried (appended to again) or given up. returns the new backoff
+int kontrolDisplay::complete(const pendingFrame &frame, int result, int backoff, QList<pendingFrame> &again)
+{
+	if(result == 0)
+		{
+		frames++;
+		bytes += frame.data.count();
+		if((frame.width == screenWidth) && (frame.height == screenHeight) && (frame.screen < 2))
+			fullFrames[frame.screen]++;
+		emit frameSent(frame.id, 0);
+		if(degraded.testAndSetOrdered(1, 0))
+			emit recovered();
+		return 0;
+		}
+
+	lock.lock();
+	bool retry = !stopping && (result != LIBUSB_ERROR_NO_DEVICE) && (frame.attempts < retries);
+	bool cancelled = !stopping && (result == LIBUSB_ERROR_INTERRUPTED);
+	lock.unlock();
+	if(cancelled)
+		{
+		// cut off behind a frame which failed, it is sent again without counting as a failure
+		again.append(frame);
+		return backoff;
+		}
+	if(retry)
+		{
+		failures++;
+		pendingFrame later = frame;
+		later.attempts++;
+		again.append(later);
+		return qBound(minimumBackoff, backoff*2, maximumBackoff);
+		}
+	emit frameSent(frame.id, result);
+	failed(result);
+	return qMax(backoff, minimumBackoff);
+}
+
+// frames to be sent again go ahead of the queue, in the order they had
+void kontrolDisplay::requeue(const QList<pendingFrame> &frames)
+{
+	if(frames.isEmpty())
+		return;
+	QMutexLocker locker(&lock);
+	pending = frames+pending;
+	wakeup.wakeOne();
+}
+
+// a frame (or a streamed part of one) is lost
+void kontrolDisplay::failed(int error)
+{
+	failures++;
+	if(error == LIBUSB_ERROR_NO_DEVICE)
+		emit transferFailed(error); // unplugged, retrying makes no sense
+	else if(degraded.testAndSetOrdered(0, 1))
+		emit transferFailed(error); // reported once until the display works again
+}
+
+// wait between two attempts, returns false if the thread is stopped meanwhile
+bool kontrolDisplay::pause(int milliseconds)
+{
+	QMutexLocker locker(&lock);
+	if(!stopping)
+		stopped.wait(&lock, milliseconds);
+	return !stopping;
+}
+
+// hand a frame to the transport: 0 or an error when it is done with it, 1 while it is still in flight
+int kontrolDisplay::write(const pendingFrame &frame, int timeout)
+{
+	QElapsedTimer transfer;
+	transfer.start();
+	int r = transport->writeDisplay(frame.id, reinterpret_cast<const unsigned char *>(frame.data.constData()), frame.data.count(), timeout);
+	busy += transfer.nsecsElapsed();
+	if(r > 0)
+		inFlight.append(frame);
+	publish();
+	return r;
+}
+
+// emit the throughput of the last second: megabytes per second of transfer time (how close the
+// bus comes to its limit) and complete frames per second and screen
+void kontrolDisplay::publish()
+{
+	qint64 elapsed = statistics.elapsed();
+	if(elapsed < 1000)
+		return;
+	quint64 sent = bytes.load();
+	double megabytesPerSecond = busy ? (sent-publishedBytes)*1000.0/busy : 0; // bytes per nanosecond * 1000 = MB/s
+	double left = (fullFrames[0].load()-publishedFrames[0])*1000.0/elapsed;
+	double right = (fullFrames[1].load()-publishedFrames[1])*1000.0/elapsed;
+	publishedBytes = sent;
+	publishedFrames[0] = fullFrames[0].load();
+	publishedFrames[1] = fullFrames[1].load();
+	busy = 0;
+	statistics.restart();
+	emit statisticsUpdated(megabytesPerSecond, left, right);
+}
+
+quint64 kontrolDisplay::frameCount() const
+{
+	return frames.load();
+}
+
+quint64 kontrolDisplay::droppedCount() const
+{
+	return dropped.load();
+}
+
+double kontrolDisplay::framesPerSecond() const
+{
+	if(!clock.isValid() || clock.elapsed() == 0)
+		return 0;
+	return frames.load()*1000.0/clock.elapsed();
+}
+
+kontrolDisplay::~kontrolDisplay()
+{
+	close();
+}
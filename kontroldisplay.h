@@ -0,0 +1,92 @@
+#ifndef _KONTROLDISPLAY_H_
+#define _KONTROLDISPLAY_H_
+
+#include <QtGlobal>
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QRect>
+#include <QThread>
+#include <QWaitCondition>
+#include "kontroltransport.h"
+
+// long-lived session for the two screens: the display interface is claimed
+// once, every frame reuses it. frames are queued by the GUI thread and sent
+// by this thread, so a slow transfer never blocks the event loop. with a
+// streaming transport the next frames are written while the last ones are
+// still in flight. failed transfers are retried with a growing backoff, if
+// that does not help the display is degraded until a transfer succeeds again.
+// the thread publishes its throughput once per second
+class kontrolDisplay : public QThread
+{
+	Q_OBJECT
+
+	public:
+		explicit kontrolDisplay(QObject *parent = 0);
+		~kontrolDisplay();
+		bool open(kontrolTransport *device);
+		void close();
+		quint64 queue(uint8_t screen, ushort x, ushort y, ushort width, ushort height, const QByteArray &frame, int priority = 0);
+		void setTransferPolicy(int timeout, int retries);
+		bool isDegraded() const;
+		quint64 failureCount() const;
+		quint64 frameCount() const;
+		quint64 droppedCount() const;
+		double framesPerSecond() const;
+
+	signals:
+		void transferFailed(int error);
+		void recovered();
+		void frameSent(quint64 id, int result);
+		void statisticsUpdated(double megabytesPerSecond, double leftFramesPerSecond, double rightFramesPerSecond);
+
+	protected:
+		void run();
+
+	private:
+		// one pending transfer, frames for the same screen and rectangle replace each other.
+		// the frame with the highest priority is sent next, equal ones in queueing order, but
+		// never ahead of an older frame it overlaps
+		struct pendingFrame
+			{
+			quint64 id;
+			int priority;
+			int attempts; // failed transfers so far
+			uint8_t screen;
+			ushort x, y, width, height;
+			QByteArray data;
+			};
+
+		static bool overlaps(const pendingFrame &a, const pendingFrame &b);
+		static bool covers(const pendingFrame &a, const pendingFrame &b);
+
+		int write(const pendingFrame &frame, int timeout);
+		int collect(bool wait, int backoff);
+		int complete(const pendingFrame &frame, int result, int backoff, QList<pendingFrame> &again);
+		void requeue(const QList<pendingFrame> &frames);
+		void failed(int error);
+		bool pause(int milliseconds);
+		void publish();
+
+		kontrolTransport *transport;
+		bool stopping;
+		quint64 lastId;
+		int timeout, retries; // per transfer in milliseconds, extra attempts per frame; guarded by lock
+		QList<pendingFrame> pending;
+		QList<pendingFrame> inFlight; // written but not finished yet, only used by the thread
+		QMutex lock;
+		QWaitCondition wakeup, stopped;
+		QAtomicInt degraded;
+		QAtomicInteger<quint64> frames, dropped, failures, bytes;
+		QAtomicInteger<quint64> fullFrames[2];
+		QElapsedTimer clock;
+
+		// statistics window of the transfer thread
+		QElapsedTimer statistics;
+		qint64 busy; // nanoseconds spent in transfers
+		quint64 publishedBytes, publishedFrames[2];
+};
+
+#endif /*_KONTROLDISPLAY_H_*/
@@ -0,0 +1,52 @@
+#ifndef _KONTROLTRANSPORT_H_
+#define _KONTROLTRANSPORT_H_
+
+#include <QtGlobal>
+#include <QList>
+
+// the outcome of a display command which was still in flight when writeDisplay() returned
+struct displayResult
+	{
+	quint64 tag;
+	int result; // 0 or a negative libusb error code
+	};
+
+// all I/O with a Komplete Kontrol keyboard: HID input and output reports and the bulk
+// transfers of the screens; readReport is called from the input thread, writeDisplay from
+// the display thread and writeReport from the GUI thread, so backends must allow that
+class kontrolTransport
+{
+	public:
+		virtual ~kontrolTransport() {}
+
+		// open the HID part of the device, false if no device was found
+		virtual bool open() = 0;
+		virtual void close() = 0;
+
+		// HID in: one report, 0 if none arrived within timeout milliseconds, negative on errors
+		virtual int readReport(unsigned char *data, int length, int timeout) = 0;
+
+		// HID out: one report, the number of written bytes or negative on errors
+		virtual int writeReport(const unsigned char *data, int length) = 0;
+
+		// display bulk out: claim the display interface, send one display command within timeout
+		// milliseconds and release the interface again. writeDisplay() returns 0 when the command
+		// was sent or a negative libusb error code of this very command (a command which failed part
+		// way must not garble the next one). streaming backends may return 1 while the command is
+		// still in flight, its result is then reported once by displayResults() under its tag
+		virtual bool attachDisplay() = 0;
+		virtual int writeDisplay(quint64 tag, const unsigned char *data, int length, int timeout) = 0;
+		virtual void detachDisplay() = 0;
+
+		// wait until everything passed to writeDisplay() left the host, returns 0 or the first
+		// error since the last call. the results stay available for displayResults()
+		virtual int flushDisplay() = 0;
+
+		// the commands which finished since the last call, in the order they were written; does not wait
+		virtual QList<displayResult> displayResults() = 0;
+
+		// USB product ID of the keyboard model, 0 if it is not known
+		virtual int productId() const = 0;
+};
+
+#endif /*_KONTROLTRANSPORT_H_*/
@@ -0,0 +1,227 @@
+#include <string.h>
+#include "lightguide.h"
+
+// firstNote is the MIDI note of the leftmost key (21 for 88 keys, 36 for 61 and 48 for 49 keys)
+lightguide::lightguide(int firstNote)
+{
+	memset(base, black, sizeof(base));
+	this->firstNote = firstNote;
+	nextId = 1;
+}
+
+void lightguide::setFirstNote(int note)
+{
+	firstNote = note;
+}
+
+// the note of the leftmost key of a keyboard with keyCount keys, an unknown size counts as 88 keys
+int lightguide::firstNoteOf(int keyCount)
+{
+	switch(keyCount)
+		{
+		case 49: return 48;
+		case 61: return 36;
+		default: return 21;
+		}
+}
+
+// static colors below the animations, keys are counted from the leftmost one
+void lightguide::setKeys(int first, int last, quint8 color)
+{
+	for(int key=qMax(0, first); key<=qMin(last, int(maxKeys)-1); key++)
+		base[key] = color;
+}
+
+// a segment of length keys running up the keyboard, its tail fading out. returns the id for remove()
+int lightguide::addChase(quint8 color, int keysPerSecond, int length, qint64 start)
+{
+	animation a;
+	a.type = animation::chase;
+	a.id = nextId++;
+	a.color = color;
+	a.speed = keysPerSecond;
+	a.length = qBound(1, length, int(maxKeys));
+	a.start = start;
+	animations.append(a);
+	return a.id;
+}
+
+// light every key whose note is in the scale, e.g. root 0 (C) and intervals 0xab5 for major
+int lightguide::addScale(int root, quint16 intervals, quint8 color)
+{
+	animation a;
+	a.type = animation::scale;
+	a.id = nextId++;
+	a.color = color;
+	a.root = root;
+	a.intervals = intervals;
+	a.start = 0;
+	animations.append(a);
+	return a.id;
+}
+
+// let a zone breathe through the four brightness levels once per period milliseconds
+int lightguide::addPulse(int first, int last, quint8 color, int period, qint64 start)
+{
+	animation a;
+	a.type = animation::pulse;
+	a.id = nextId++;
+	a.color = color;
+	a.first = qMax(0, first);
+	a.last = qMin(last, int(maxKeys)-1);
+	a.period = qMax(1, period);
+	a.start = start;
+	animations.append(a);
+	return a.id;
+}
+
+void lightguide::remove(int id)
+{
+	for(int i=0;i<animations.count();i++)
+		if(animations[i].id == id)
+			animations.removeAt(i--);
+}
+
+void lightguide::clearAnimations()
+{
+	animations.clear();
+}
+
+// true if frames change over time, a scale overlay alone is static
+bool lightguide::isAnimated() const
+{
+	for(const animation &a : animations)
+		if(a.type != animation::scale)
+			return true;
+	return false;
+}
+
+// the 0x81 report at time milliseconds: the static colors, then every animation in the order it was added
+QByteArray lightguide::frame(qint64 time) const
+{
+	QByteArray report(1+maxKeys, '\0');
+	report[0] = 0x81;
+	quint8 *keys = reinterpret_cast<quint8 *>(report.data())+1;
+	memcpy(keys, base, maxKeys);
+
+	for(const animation &a : animations)
+		switch(a.type)
+			{
+			case animation::scale:
+				for(int key=0;key<maxKeys;key++)
+					if(a.intervals & (1 << (((firstNote+key-a.root)%12+12)%12)))
+						keys[key] = a.color;
+				break;
+			case animation::pulse:
+				{
+				// triangle wave through the levels 0-3 and back
+				int step = int(((time-a.start)%a.period+a.period)%a.period*6/a.period);
+				int level = step > 3 ? 6-step : step;
+				for(int key=a.first;key<=a.last;key++)
+					keys[key] = shade(a.color, level);
+				break;
+				}
+			case animation::chase:
+				{
+				int head = int((((time-a.start)*a.speed/1000)%maxKeys+maxKeys)%maxKeys);
+				for(int i=0;i<a.length;i++)
+					keys[(head-i+maxKeys)%maxKeys] = shade(a.color, 3-i*4/a.length);
+				break;
+				}
+			}
+	return report;
+}
+
+// a palette color at brightness 0 (dim) to 3 (full), black stays black
+quint8 lightguide::shade(quint8 color, int level)
+{
+	return color == black ? quint8(black) : quint8(color+qBound(0, level, 3));
+}
+
+lightguideEngine::lightguideEngine(QObject *parent) : QObject(parent)
+{
+	setRate(30);
+	budget = 25;
+	debt = 0;
+	sentFrames = 0;
+	unchangedFrames = 0;
+	skippedFrames = 0;
+	clock.start();
+	timer.setTimerType(Qt::PreciseTimer);
+	connect(&timer, SIGNAL(timeout()), this, SLOT(tick()));
+}
+
+// the lightguide to change, call update() afterwards
+lightguide &lightguideEngine::keys()
+{
+	return guide;
+}
+
+// the clock animations are started on
+qint64 lightguideEngine::time() const
+{
+	return clock.elapsed();
+}
+
+// render with the next tick and keep ticking while something is animated
+void lightguideEngine::update()
+{
+	if(!timer.isActive())
+		timer.start(period);
+}
+
+void lightguideEngine::setRate(int framesPerSecond)
+{
+	period = 1000/qBound(1, framesPerSecond, 1000);
+	if(timer.isActive())
+		timer.start(period);
+}
+
+// share of every tick which LED writes may take on average
+void lightguideEngine::setBudget(int percent)
+{
+	budget = qBound(1, percent, 100);
+}
+
+void lightguideEngine::tick()
+{
+	qint64 allowance = qint64(period)*1000*budget/100; // microseconds per tick
+	if(debt > 0)
+		{
+		// the last write took longer than its share, this tick pays it back
+		debt = qMax<qint64>(0, debt-allowance);
+		skippedFrames++;
+		return;
+		}
+
+	QByteArray frame = guide.frame(clock.elapsed());
+	if(frame == sent)
+		unchangedFrames++;
+	else
+		{
+		QElapsedTimer write;
+		write.start();
+		emit frameReady(frame);
+		debt = qMax<qint64>(0, write.nsecsElapsed()/1000-allowance);
+		sent = frame;
+		sentFrames++;
+		}
+	if(!guide.isAnimated() && !debt)
+		timer.stop();
+}
+
+quint64 lightguideEngine::sentCount() const
+{
+	return sentFrames;
+}
+
+quint64 lightguideEngine::unchangedCount() const
+{
+	return unchangedFrames;
+}
+
+// ticks which were left out to keep LED writes within the budget
+quint64 lightguideEngine::skippedCount() const
+{
+	return skippedFrames;
+}
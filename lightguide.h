@@ -0,0 +1,88 @@
+#ifndef _LIGHTGUIDE_H_
+#define _LIGHTGUIDE_H_
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+
+// per-key colors of the lightguide (up to 88 keys) and the animations drawn over them.
+// colors are palette bytes like in the 0xa4 report, a color plus 0-3 is its brightness.
+// frame() renders the 0x81 report for a point in time and has no other state, so the
+// animations can be rendered and checked without a keyboard or a timer
+class lightguide
+{
+	public:
+		enum { maxKeys = 88 };
+		enum color { black = 0x00, red = 0x04, orange = 0x08, yellow = 0x14, green = 0x1c, mint = 0x20, cyan = 0x24, blue = 0x2c, purple = 0x38 };
+
+		explicit lightguide(int firstNote = 21);
+		void setFirstNote(int note);
+		static int firstNoteOf(int keyCount);
+		void setKeys(int first, int last, quint8 color);
+		int addChase(quint8 color, int keysPerSecond, int length, qint64 start);
+		int addScale(int root, quint16 intervals, quint8 color);
+		int addPulse(int first, int last, quint8 color, int period, qint64 start);
+		void remove(int id);
+		void clearAnimations();
+		bool isAnimated() const;
+		QByteArray frame(qint64 time) const;
+		static quint8 shade(quint8 color, int level);
+
+	private:
+		struct animation
+			{
+			enum animationType { chase, scale, pulse } type;
+			int id;
+			quint8 color;
+			int first, last; // key range of a pulse
+			int speed, length; // keys per second and lit keys of a chase
+			int period; // milliseconds of one pulse
+			int root; // note of a scale, intervals has one bit per semitone above it
+			quint16 intervals;
+			qint64 start;
+			};
+
+		quint8 base[maxKeys];
+		int firstNote, nextId;
+		QList<animation> animations;
+};
+
+// plays a lightguide on a frame clock: every tick renders a frame and hands it out only if it
+// differs from the last one. LED writes get a share of each tick (the budget), after a slow
+// write ticks are skipped until the time is paid back, so the lightguide never crowds out
+// display or input I/O. the clock stops when nothing is animated
+class lightguideEngine : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit lightguideEngine(QObject *parent = 0);
+		lightguide &keys();
+		qint64 time() const;
+		void update();
+		void setRate(int framesPerSecond);
+		void setBudget(int percent);
+		quint64 sentCount() const;
+		quint64 unchangedCount() const;
+		quint64 skippedCount() const;
+
+	signals:
+		void frameReady(const QByteArray &report);
+
+	private slots:
+		void tick();
+
+	private:
+		lightguide guide;
+		QByteArray sent;
+		QTimer timer;
+		QElapsedTimer clock;
+		int period, budget; // milliseconds per tick, percent of a tick for LED writes
+		qint64 debt; // microseconds of LED writes above the budget
+		quint64 sentFrames, unchangedFrames, skippedFrames;
+};
+
+#endif /*_LIGHTGUIDE_H_*/
@@ -0,0 +1,220 @@
+#include <string.h>
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QThread>
+#include "mocktransport.h"
+
+// the script has one input report per line: delay in milliseconds and the report bytes in hex,
+// e.g. "10 aa00...", lines starting with # are comments
+mockTransport::mockTransport(const QString &scriptFile, const QString &recordFile)
+{
+	this->recordFile = recordFile;
+	position = 0;
+	pid = 0;
+	attachLatency = 0;
+	attaches = 0;
+	due = 0;
+	recording = true;
+
+	QFile file(scriptFile);
+	if(scriptFile.isEmpty() || !file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return;
+	while(!file.atEnd())
+		{
+		QString line = QString::fromLatin1(file.readLine()).trimmed();
+		if(line.isEmpty() || line.startsWith('#'))
+			continue;
+		QStringList fields = line.split(' ', QString::SkipEmptyParts);
+		if(fields.count() == 2)
+			addInput(fields[0].toInt(), QByteArray::fromHex(fields[1].toLatin1()));
+		}
+}
+
+bool mockTransport::open()
+{
+	QMutexLocker locker(&lock);
+	position = 0;
+	due = script.isEmpty() ? 0 : script[0].delay;
+	recorded.clear();
+	clock.start();
+	return true;
+}
+
+void mockTransport::close()
+{
+	QMutexLocker locker(&lock);
+	if(!clock.isValid())
+		return;
+	int reports = 0;
+	qint64 bytes = 0;
+	for(const transportRecord &r : recorded)
+		{
+		if(r.type == transportRecord::report)
+			reports++;
+		bytes += r.data.count();
+		}
+	qDebug() << "mock device:" << position << "input reports replayed," << reports << "reports and" << recorded.count()-reports << "display commands recorded," << bytes << "bytes";
+	locker.unlock();
+	if(!recordFile.isEmpty())
+		saveRecords(recordFile);
+	clock.invalidate();
+}
+
+// hand out the next scripted report once it is due, otherwise wait up to timeout milliseconds for it
+int mockTransport::readReport(unsigned char *data, int length, int timeout)
+{
+	QMutexLocker locker(&lock);
+	if(position >= script.count())
+		{
+		// nothing left to replay, behave like an idle keyboard
+		locker.unlock();
+		if(timeout != 0)
+			QThread::msleep(timeout > 0 ? timeout : 250);
+		return 0;
+		}
+
+	qint64 wait = due - clock.elapsed();
+	if(wait > 0)
+		{
+		if(timeout == 0)
+			return 0;
+		if((timeout > 0) && (wait > timeout))
+			wait = timeout;
+		locker.unlock();
+		QThread::msleep(wait);
+		locker.relock();
+		if((position >= script.count()) || (clock.elapsed() < due))
+			return 0;
+		}
+
+	const QByteArray &report = script[position].data;
+	const int count = qMin(length, report.count());
+	memcpy(data, report.constData(), count);
+	position++;
+	if(position < script.count())
+		due += script[position].delay;
+	return count;
+}
+
+int mockTransport::writeReport(const unsigned char *data, int length)
+{
+	record(transportRecord::report, data, length);
+	return length;
+}
+
+// a keyboard takes a while to open the device and claim the display interface, the stand-in only as long as it is told
+bool mockTransport::attachDisplay()
+{
+	QMutexLocker locker(&lock);
+	attaches++;
+	int latency = attachLatency;
+	locker.unlock();
+	if(latency > 0)
+		QThread::msleep(latency);
+	return true;
+}
+
+int mockTransport::writeDisplay(quint64 tag, const unsigned char *data, int length, int timeout)
+{
+	Q_UNUSED(tag);
+	Q_UNUSED(timeout);
+	record(transportRecord::display, data, length);
+	return 0;
+}
+
+void mockTransport::detachDisplay()
+{}
+
+int mockTransport::flushDisplay()
+{
+	return 0;
+}
+
+// every command is recorded before writeDisplay() returns, nothing is ever in flight
+QList<displayResult> mockTransport::displayResults()
+{
+	return QList<displayResult>();
+}
+
+int mockTransport::productId() const
+{
+	return pid;
+}
+
+// milliseconds every attachDisplay() takes, 0 (the default) returns at once
+void mockTransport::setAttachLatency(int milliseconds)
+{
+	QMutexLocker locker(&lock);
+	attachLatency = qMax(0, milliseconds);
+}
+
+// how often the display was attached since the stand-in was created
+int mockTransport::attachCount() const
+{
+	QMutexLocker locker(&lock);
+	return attaches;
+}
+
+// the model the stand-in claims to be, e.g. for the size of the lightguide
+void mockTransport::setProductId(int productId)
+{
+	pid = productId;
+}
+
+// queue an input report delay milliseconds after the previous one
+void mockTransport::addInput(int delay, const QByteArray &report)
+{
+	QMutexLocker locker(&lock);
+	scriptedReport r;
+	r.delay = delay;
+	r.data = report;
+	script.append(r);
+}
+
+// without recording the sent data is only accepted, e.g. for throughput measurements
+void mockTransport::setRecording(bool enabled)
+{
+	QMutexLocker locker(&lock);
+	recording = enabled;
+}
+
+QList<transportRecord> mockTransport::records() const
+{
+	QMutexLocker locker(&lock);
+	return recorded;
+}
+
+// one line per record: time in microseconds, "report" or "display" and the bytes in hex
+bool mockTransport::saveRecords(const QString &fileName) const
+{
+	QFile file(fileName);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		return false;
+	for(const transportRecord &r : records())
+		{
+		file.write(QByteArray::number(r.time));
+		file.write(r.type == transportRecord::report ? " report " : " display ");
+		file.write(r.data.toHex());
+		file.write("\n");
+		}
+	return true;
+}
+
+void mockTransport::record(transportRecord::recordType type, const unsigned char *data, int length)
+{
+	QMutexLocker locker(&lock);
+	if(!recording)
+		return;
+	transportRecord r;
+	r.type = type;
+	r.time = clock.isValid() ? clock.nsecsElapsed()/1000 : 0;
+	r.data = QByteArray(reinterpret_cast<const char *>(data), length);
+	recorded.append(r);
+}
+
+mockTransport::~mockTransport()
+{
+	close();
+}
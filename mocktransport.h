@@ -0,0 +1,67 @@
+#ifndef _MOCKTRANSPORT_H_
+#define _MOCKTRANSPORT_H_
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include "kontroltransport.h"
+
+// one report or display command which the application sent, with its time since open()
+struct transportRecord
+	{
+	enum recordType { report, display } type;
+	qint64 time; // microseconds
+	QByteArray data;
+	};
+
+// in-process stand-in for a keyboard: replays scripted input reports and records everything
+// the application sends, so the I/O paths can run headless
+class mockTransport : public kontrolTransport
+{
+	public:
+		explicit mockTransport(const QString &scriptFile = QString(), const QString &recordFile = QString());
+		~mockTransport();
+		bool open();
+		void close();
+		int readReport(unsigned char *data, int length, int timeout);
+		int writeReport(const unsigned char *data, int length);
+		bool attachDisplay();
+		int writeDisplay(quint64 tag, const unsigned char *data, int length, int timeout);
+		void detachDisplay();
+		int flushDisplay();
+		QList<displayResult> displayResults();
+		int productId() const;
+
+		void addInput(int delay, const QByteArray &report);
+		void setRecording(bool enabled);
+		void setProductId(int productId);
+		void setAttachLatency(int milliseconds);
+		int attachCount() const;
+		QList<transportRecord> records() const;
+		bool saveRecords(const QString &fileName) const;
+
+	private:
+		// an input report which is due delay milliseconds after the previous one
+		struct scriptedReport
+			{
+			int delay;
+			QByteArray data;
+			};
+
+		void record(transportRecord::recordType type, const unsigned char *data, int length);
+
+		QString recordFile;
+		QList<scriptedReport> script;
+		int position;
+		int pid;
+		int attachLatency, attaches;
+		qint64 due;
+		bool recording;
+		QList<transportRecord> recorded;
+		mutable QMutex lock;
+		QElapsedTimer clock;
+};
+
+#endif /*_MOCKTRANSPORT_H_*/
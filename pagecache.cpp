@@ -0,0 +1,220 @@
+#include <QtConcurrentRun>
+#include <QFont>
+#include "pagecache.h"
+
+bool controlSettings::operator==(const controlSettings &other) const
+{
+	return (buttonMode == other.buttonMode) && (buttonCC == other.buttonCC) && (buttonChannel == other.buttonChannel) && (buttonColor == other.buttonColor) && (buttonDescription == other.buttonDescription) && (knobMode == other.knobMode) && (knobCC == other.knobCC) && (knobChannel == other.knobChannel) && (knobDescription == other.knobDescription);
+}
+
+// pictures are compared by identity, the imageCache hands out the same image for an unchanged file
+bool pageSettings::operator==(const pageSettings &other) const
+{
+	for(int i=0;i<32;i++)
+		if(!(controls[i] == other.controls[i]))
+			return false;
+	return (sliderFunctions == other.sliderFunctions) && (sliderScreen == other.sliderScreen) && (colors == other.colors) && (backgrounds[0].cacheKey() == other.backgrounds[0].cacheKey()) && (backgrounds[1].cacheKey() == other.backgrounds[1].cacheKey());
+}
+
+pageCache::pageCache(QObject *parent) : QObject(parent)
+{
+	outdated = false;
+	known = false;
+	connect(&worker, SIGNAL(finished()), this, SLOT(built()));
+}
+
+// new settings: the prepared pages are invalid until they are built again, unchanged ones are ignored
+void pageCache::update(const pageSettings &settings)
+{
+	if(known && (settings == latest))
+		return;
+	latest = settings;
+	known = true;
+	pages.clear();
+	if(worker.isRunning())
+		{
+		outdated = true;
+		return;
+		}
+	worker.setFuture(QtConcurrent::run(&pageCache::build, settings));
+}
+
+// the widgets no longer match the latest settings, a running build is thrown away when it finishes
+void pageCache::invalidate()
+{
+	known = false;
+	outdated = false;
+	pages.clear();
+}
+
+bool pageCache::isReady() const
+{
+	return !pages.isEmpty();
+}
+
+preparedPage pageCache::page(int page) const
+{
+	return pages.value(page);
+}
+
+// the 0xa1 report with the buttons, knobs and button lights of a page
+QByteArray pageCache::knobsAndButtons(const pageSettings &settings, int page)
+{
+	QByteArray report;
+	report.append(QByteArray::fromHex("a1"));
+	for(int i=page*8;i<=page*8+7;i++) // buttons
+		{
+		const controlSettings &c = settings.controls[i];
+		switch(c.buttonMode)
+			{
+			case 0: report.append(QByteArray::fromHex("00")); break;
+			case 4: report.append(QByteArray::fromHex("04")); break;
+			default: report.append(QByteArray::fromHex("03")); break;
+			}
+		report.append(c.buttonCC);
+		report.append(c.buttonChannel-1);
+		switch(c.buttonMode)
+			{
+			case 1: report.append(QByteArray::fromHex("3c")); break; // toggle
+			case 3: report.append(QByteArray::fromHex("3e")); break; // gate
+			default: report.append(QByteArray::fromHex("3d")); break; // any other
+			}
+		report.append(QByteArray::fromHex("0000"));
+		if(c.buttonMode == 4)
+			report.append(c.buttonCC);
+		else
+			report.append(QByteArray::fromHex("7f"));
+		report.append(QByteArray::fromHex("0000000000"));
+		}
+	for(int i=page*8;i<=page*8+7;i++) // knobs
+		{
+		const controlSettings &c = settings.controls[i];
+		switch(c.knobMode)
+			{
+			case 0: report.append(QByteArray::fromHex("00")); break;
+			case 1: report.append(QByteArray::fromHex("04")); break;
+			default: report.append(QByteArray::fromHex("03")); break;
+			}
+		report.append(c.knobCC);
+		report.append(c.knobChannel-1);
+		report.append(QByteArray::fromHex("3c00007f0000000000"));
+		}
+	for(int i=page*8;i<=page*8+7;i++) // background light of the buttons
+		switch(settings.controls[i].buttonColor)
+			{
+			case 0: report.append(QByteArray::fromHex("00")); break; // off
+			case 1: report.append(QByteArray::fromHex("1f")); break; // white
+			case 2: report.append(QByteArray::fromHex("01")); break; // red
+			case 3: report.append(QByteArray::fromHex("0a")); break; // blue
+			case 4: report.append(QByteArray::fromHex("03")); break; // orange
+			case 5: report.append(QByteArray::fromHex("09")); break; // cyan
+			case 6: report.append(QByteArray::fromHex("07")); break; // green
+			case 7: report.append(QByteArray::fromHex("0c")); break; // violet
+			case 8: report.append(QByteArray::fromHex("05")); break; // yellow
+			case 9: report.append(QByteArray::fromHex("0e")); break; // magenta
+			case 10: report.append(QByteArray::fromHex("08")); break; // mint
+			case 11: report.append(QByteArray::fromHex("0d")); break; // purple
+			case 12: report.append(QByteArray::fromHex("10")); break; // pink
+			}
+	report.append(QByteArray::fromHex("000000")); // suffix-data, always the same
+	return report;
+}
+
+// the texts, boxes and lines of a screen (0: knobs/buttons 1-4, 1: 5-8) on a page
+QList<screenCompositor::item> pageCache::labels(const pageSettings &settings, int page, int screen)
+{
+	QList<screenCompositor::item> items;
+	static const QFont sliderFont("Arial", 16, QFont::Bold);
+	static const QFont buttonFont("Arial", 13, QFont::Bold);
+	static const QFont knobFont("Arial", 10);
+	static const QFont descriptionFont("Arial", 9);
+	int x[4] = { 10, 130, 250, 370 };
+
+	if(settings.sliderScreen == screen)
+		{
+		for(int i=0;i<3;i++)
+			items.append(screenCompositor::text(QPoint(30, 110+30*i), settings.sliderFunctions.value(i), sliderFont, settings.colors["slider"]));
+		items.append(screenCompositor::text(QPoint(370, 140), "page "+QString::number(page+1)+"/4", sliderFont, settings.colors["slider"]));
+		}
+
+	for(int i=0;i<4;i++)
+		{
+		const controlSettings &c = settings.controls[page*8+screen*4+i];
+		QString caption;
+		switch(c.buttonMode)
+			{
+			case 0: caption = "OFF"; break;
+			case 4: caption = "PRG "+QString::number(c.buttonCC); break;
+			default: caption = "CC "+QString::number(c.buttonCC); break;
+			}
+		items.append(screenCompositor::text(QRect(x[i], 10, 100, 27), Qt::AlignCenter, caption, buttonFont, settings.colors["CC"]));
+		}
+
+	for(int i=0;i<4;i++)
+		{
+		const controlSettings &c = settings.controls[page*8+screen*4+i];
+		QString caption;
+		switch(c.knobMode)
+			{
+			case 0: caption = "OFF"; break;
+			case 1: caption = "PRESET"; break;
+			default: caption = "CC "+QString::number(c.knobCC); break;
+			}
+		items.append(screenCompositor::text(QPoint(x[i], 245), caption, knobFont, settings.colors["CC"]));
+		}
+
+	for(int i=0;i<4;i++)
+		{
+		const controlSettings &c = settings.controls[page*8+screen*4+i];
+		if(c.knobMode == 2)
+			items.append(screenCompositor::text(QPoint(x[i], 263), c.knobDescription, descriptionFont, settings.colors["parameter"], 106)); // up to the divider line
+		if(c.buttonMode != 0)
+			items.append(screenCompositor::text(QRect(x[i], 32, 100, 13), Qt::AlignCenter, c.buttonDescription, descriptionFont, settings.colors["parameter"]));
+		}
+
+	for(int i=0;i<4;i++)
+		items.append(screenCompositor::box(QRect(x[i], 10, 100, 36), settings.colors["divider"]));
+	for(int lineX=120;lineX<480;lineX+=120)
+		items.append(screenCompositor::line(QPoint(lineX, 225), QPoint(lineX, 272), settings.colors["divider"]));
+	return items;
+}
+
+// worker thread: reports and composited screens of all pages. one compositor per screen goes through
+// the pages, so only what differs from the page before is drawn and the text layouts are shared
+QVector<preparedPage> pageCache::build(const pageSettings &settings)
+{
+	QVector<preparedPage> built(pageCount);
+	screenCompositor compositor[2];
+	for(int page=0;page<pageCount;page++)
+		{
+		built[page].report = knobsAndButtons(settings, page);
+		for(int screen=0;screen<2;screen++)
+			{
+			compositor[screen].setBackground(settings.backgrounds[screen], QRect(0, 65, 480, 140));
+			compositor[screen].setLabels(labels(settings, page, screen));
+			compositor[screen].update();
+			built[page].screens[screen] = compositor[screen].image().convertToFormat(QImage::Format_RGB16);
+			}
+		}
+	return built;
+}
+
+void pageCache::built()
+{
+	if(!known)
+		return;
+	if(outdated)
+		{
+		// the settings changed meanwhile, this result is thrown away
+		outdated = false;
+		worker.setFuture(QtConcurrent::run(&pageCache::build, latest));
+		return;
+		}
+	pages = worker.result();
+	emit ready();
+}
+
+pageCache::~pageCache()
+{
+	worker.waitForFinished();
+}
@@ -0,0 +1,81 @@
+#ifndef _PAGECACHE_H_
+#define _PAGECACHE_H_
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QColor>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "screencompositor.h"
+
+// the settings of one of the 32 knob/button pairs (8 per page)
+struct controlSettings
+	{
+	int buttonMode, buttonCC, buttonChannel, buttonColor;
+	QString buttonDescription;
+	int knobMode, knobCC, knobChannel;
+	QString knobDescription;
+	bool operator==(const controlSettings &other) const;
+	};
+
+// copy of everything the pages depend on, taken from the widgets by the GUI thread
+struct pageSettings
+	{
+	controlSettings controls[32];
+	QStringList sliderFunctions;
+	int sliderScreen; // 0 or 1, -1 if the slider functions are not shown
+	QMap<QString,QColor> colors;
+	QImage backgrounds[2]; // scaled to 480x140
+	bool operator==(const pageSettings &other) const;
+	};
+
+// what a page switch sends: the knob and button report (0xa1) and both screens in RGB565
+struct preparedPage
+	{
+	QByteArray report;
+	QImage screens[2];
+	};
+
+// the four pages built ahead of time on a worker thread, so a page switch only sends prepared
+// buffers. update() starts a new build whenever the settings change, a page is only handed out
+// when it was built from the latest settings. invalidate() drops the pages when the widgets were
+// edited without an update(), until the next update() no page is ready
+class pageCache : public QObject
+{
+	Q_OBJECT
+
+	public:
+		static const int pageCount = 4;
+
+		explicit pageCache(QObject *parent = 0);
+		~pageCache();
+		void update(const pageSettings &settings);
+		void invalidate();
+		bool isReady() const;
+		preparedPage page(int page) const;
+		static QByteArray knobsAndButtons(const pageSettings &settings, int page);
+		static QList<screenCompositor::item> labels(const pageSettings &settings, int page, int screen);
+
+	signals:
+		void ready();
+
+	private slots:
+		void built();
+
+	private:
+		static QVector<preparedPage> build(const pageSettings &settings);
+
+		QFutureWatcher<QVector<preparedPage> > worker;
+		pageSettings latest;
+		bool known; // latest holds the settings of the last update()
+		bool outdated; // the running build is for older settings
+		QVector<preparedPage> pages; // empty while not ready
+};
+
+#endif /*_PAGECACHE_H_*/
@@ -1,11 +1,7 @@
 #include <QtGlobal>
 #include <iostream>
-#ifdef Q_OS_MACOS
-#include "/usr/local/Cellar/libusb/1.0.22/include/libusb-1.0/libusb.h"
-#else
-#include <libusb-1.0/libusb.h>
-#endif
 #include <math.h>
+#include <string.h>
 
 using namespace std;
 #include <QApplication>
@@ -19,27 +15,32 @@ using namespace std;
 #include <QRgb>
 #include <QStringList>
 #include <QPainter>
+#include <QStatusBar>
+#include "displayencoder.h"
 #include "qkontrol.h"
 
+// transfer priorities of the screen parts, a higher one reaches the keyboard first
+static const int valuePriority = 3; // knob value overlays
+static const int labelPriority = 2; // button and knob labels, whole pages
+static const int statusPriority = 1; // slider functions and page number
+static const int backgroundPriority = 0;
+
+// where pageCache::labels() puts them on a screen
+static const QRect buttonLabelArea(0, 0, 480, 50);
+static const QRect knobLabelArea(0, 225, 480, 47);
+static const QRect statusArea(0, 90, 480, 90);
+
+// where the value overlay of each encoder is drawn: x/y of the display command and the screen
+// (found with the former decimal encoding, hence the hex digits)
+static const int knobValueX[8] = { 0x90, 0x108, 0x180, 0x798, 0x90, 0x108, 0x180, 0x798 };
+static const int knobValueY[8] = { 0x309, 0x309, 0x309, 0x306, 0x309, 0x309, 0x309, 0x306 };
+static const int knobValueScreen[8] = { 0, 0, 0, 0, 1, 1, 1, 1 };
+
 qkontrolWindow::qkontrolWindow(QWidget* parent /* = 0 */, Qt::WindowFlags flags /* = 0 */) : QMainWindow(parent, flags)
 {
-        // search for the usb device and open it
+        // keyboards are opened by the device manager as soon as they are connected, each one
+        // gets the current settings and screens when it shows up
         res = hid_init();
-	QList<int> pids;
-	pids << 0x1860 << 0x1610 << 0x1620 << 0x1630; // try the device ids for 49-, 61- and 88-key versions
-
-	for(int i=0; i<pids.count(); i++)
-		{
-		pid = pids[i];
-		handle = hid_open(0x17cc, pid, NULL);
-		if(handle)
-			break;
-		}
-	if(!handle)
-		{
-		QMessageBox::critical(this, "no Komplete Kontrol found", "No Komplete Kontrol MK2 keyboard could be found. Please check if the device is turned on and connected to the PC! The program will be closed now");
-		exit(0);
-		}
 
 #ifdef Q_OS_MACOS
 	// kill the NI services which are blocking the device
@@ -51,7 +52,26 @@ qkontrolWindow::qkontrolWindow(QWidget* parent /* = 0 */, Qt::WindowFlags flags
 		}
 #endif
 
-	hid_set_nonblocking(handle, 1);
+	knobChangesCollapsed = 0;
+	presetsApplied = 0;
+	pageSwitches = 0;
+	slowPageSwitches = 0;
+	presetLatency = 0;
+	memset(knobValues, 0, sizeof(knobValues));
+
+	// the knob value overlays are paced per screen, the labels and backgrounds go out with the composed screens.
+	// QKONTROL_DISPLAY_RATE=<fps> changes the default of 60 ticks per second
+	for(int screen=0;screen<2;screen++)
+		regions.addRegion("values", screen, valuePriority, 60);
+	if(qEnvironmentVariableIsSet("QKONTROL_DISPLAY_RATE"))
+		regions.setRate(qgetenv("QKONTROL_DISPLAY_RATE").toInt());
+	connect(&regions, SIGNAL(flush(int, quint32)), this, SLOT(flushRegion(int, quint32)));
+	connect(&renderer, SIGNAL(rendered(deviceTransaction *)), this, SLOT(screensRendered(deviceTransaction *)));
+	qDebug() << "display: using the" << displayEncoder::kernelName() << "pixel encoder";
+
+	connect(&devices, SIGNAL(deviceAdded(kontrolDevice *)), this, SLOT(deviceAdded(kontrolDevice *)));
+	connect(&devices, SIGNAL(deviceAttached(kontrolDevice *)), this, SLOT(deviceAttached(kontrolDevice *)));
+	connect(&devices, SIGNAL(deviceDetached(kontrolDevice *)), this, SLOT(deviceDetached(kontrolDevice *)));
 
 	setupUi(this);
 
@@ -61,6 +81,11 @@ qkontrolWindow::qkontrolWindow(QWidget* parent /* = 0 */, Qt::WindowFlags flags
 	allColors["parameter"] = QColor(255, 255, 255);
 	allColors["divider"] = QColor(128, 128, 255);
 	allColors["value"] = QColor(0, 255, 0);
+	valueTiles.setColor(allColors["value"]);
+
+	// decoded background pictures, QKONTROL_IMAGE_CACHE=<megabytes> changes the default limit of 16 MB
+	if(qEnvironmentVariableIsSet("QKONTROL_IMAGE_CACHE"))
+		backgrounds.setCapacity(qgetenv("QKONTROL_IMAGE_CACHE").toInt());
 	QPixmap pixmapsliderscolor(color_sliders->width()-4, color_sliders->height()-4);
 	QPixmap pixmapCCcolor(color_CC->width()-4, color_CC->height()-4);
 	QPixmap pixmapParametercolor(color_parameters->width()-4, color_parameters->height()-4);
@@ -130,10 +155,15 @@ qkontrolWindow::qkontrolWindow(QWidget* parent /* = 0 */, Qt::WindowFlags flags
 	connect(radioButton_switch_2, SIGNAL(toggled(bool)), this, SLOT(updatePedalview()));
 
 
-	// process incoming HID data every 10 ms
-	QTimer *hid_data = new QTimer(this);
-	connect(hid_data, SIGNAL(timeout()), this, SLOT(updateValues()));
-	hid_data->start(10);
+	// with several keyboards either all of them show the same (mirrored) or only the selected one is driven
+	deviceSelector = new QComboBox(this);
+	deviceSelector->addItem("all keyboards (mirrored)");
+	statusBar()->addPermanentWidget(deviceSelector);
+	// the throughput is shown in the status bar, QKONTROL_DISPLAY_STATISTICS=1 also logs it every second
+	logDisplayStatistics = qEnvironmentVariableIsSet("QKONTROL_DISPLAY_STATISTICS");
+	displayThroughput = new QLabel(this);
+	statusBar()->addPermanentWidget(displayThroughput);
+	connect(deviceSelector, SIGNAL(currentIndexChanged(int)), this, SLOT(selectDevice(int)));
 
 	// keymap slot functions
 	QList<QComboBox *> allKModes = tabWidget->findChildren<QComboBox *>(QRegExp("^k_mode_"));
@@ -160,6 +190,23 @@ qkontrolWindow::qkontrolWindow(QWidget* parent /* = 0 */, Qt::WindowFlags flags
 
 	connect(p_mode_cont_2, SIGNAL(currentIndexChanged(int)), this, SLOT(updateWidgets()));
 
+	// the prepared pages are dropped as soon as a widget they are built from is edited
+	QList<QComboBox *> allPageBoxes = tabWidget->findChildren<QComboBox *>(QRegExp("^(b_mode|b_color|k_mode)_"));
+	for(QComboBox *cb : allPageBoxes)
+		connect(cb, SIGNAL(currentIndexChanged(int)), this, SLOT(pageWidgetsChanged()));
+	QList<QSpinBox *> allPageSpinBoxes = tabWidget->findChildren<QSpinBox *>(QRegExp("^(b_CC|b_channel|k_CC|k_channel|s_CC)_"));
+	for(QSpinBox *sb : allPageSpinBoxes)
+		connect(sb, SIGNAL(valueChanged(int)), this, SLOT(pageWidgetsChanged()));
+	QList<QLineEdit *> allDescriptions = tabWidget->findChildren<QLineEdit *>(QRegExp("^(b|k)_description_"));
+	for(QLineEdit *le : allDescriptions)
+		connect(le, SIGNAL(textChanged(const QString &)), this, SLOT(pageWidgetsChanged()));
+	QList<QToolBox *> allSliderBoxes = tabWidget->findChildren<QToolBox *>(QRegExp("^s_toolbox"));
+	for(QToolBox *tb : allSliderBoxes)
+		connect(tb, SIGNAL(currentChanged(int)), this, SLOT(pageWidgetsChanged()));
+	connect(p_ScreenCC, SIGNAL(currentIndexChanged(int)), this, SLOT(pageWidgetsChanged()));
+	connect(graphicsViewScreen1, SIGNAL(imageChanged()), this, SLOT(pageWidgetsChanged()));
+	connect(graphicsViewScreen2, SIGNAL(imageChanged()), this, SLOT(pageWidgetsChanged()));
+
 	// color picker
 	connect(color_sliders, SIGNAL(clicked()), this, SLOT(setSlidertextcolor()));
 	connect(color_CC, SIGNAL(clicked()), this, SLOT(setCCtextcolor()));
@@ -176,18 +223,33 @@ qkontrolWindow::qkontrolWindow(QWidget* parent /* = 0 */, Qt::WindowFlags flags
 	connect(toolButton_k_left, SIGNAL(clicked()), this, SLOT(k_goLeft()));
 	connect(toolButton_k_right, SIGNAL(clicked()), this, SLOT(k_goRight()));
 
-	// default button background lightning array
-	lightArray = QByteArray::fromHex("80000000000000000000000000000000000000000000000000000000000000000000FF00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000");
+	// default button background lightning, LED changes are written once per frame tick
+	lights.set("pageRight", buttonLights::on);
+	connect(&lights, SIGNAL(changed()), this, SLOT(setButtons()));
 	setButtons();
 
+	// lightguide animations, QKONTROL_LIGHTGUIDE=chase, scale or pulse starts one of them
+	connect(&guide, SIGNAL(frameReady(QByteArray)), this, SLOT(setLightguide(QByteArray)));
+	QByteArray animation = qgetenv("QKONTROL_LIGHTGUIDE");
+	if(animation == "chase")
+		guide.keys().addChase(lightguide::cyan, 24, 8, guide.time());
+	else if(animation == "scale")
+		guide.keys().addScale(0, 0xab5, lightguide::green); // C major
+	else if(animation == "pulse")
+		guide.keys().addPulse(0, lightguide::maxKeys-1, lightguide::purple, 2000, guide.time());
+	if(!animation.isEmpty())
+		guide.update();
+
 	// other slot functions
 	connect(loadButton, SIGNAL(clicked()), this, SLOT(getFileName()));
 	connect(saveButton, SIGNAL(clicked()), this, SLOT(save()));
 	connect(submitButton, SIGNAL(clicked()), this, SLOT(setKeyzones()));
 
-	// initial submit
+	// initial submit, keyboards found later get it when they are attached
 	setKeyzones();
 	updateWidgets();
+	statusBar()->showMessage("No Komplete Kontrol MK2 keyboard connected, waiting for it");
+	devices.start();
 }
 
 void qkontrolWindow::updatePedalview()
@@ -307,54 +369,79 @@ void qkontrolWindow::updateWidgets()
 
 }
 
+// fetch everything the input thread has queued since the last wakeup
 void qkontrolWindow::updateValues()
 {
-	unsigned char buf[91];
-	res = 0;
+	// only the newest value of an encoder needs to be rendered, the changes are handed to the
+	// overlay scheduler which draws them with the next display tick
+	kontrolDevice *source = qobject_cast<kontrolDevice *>(sender());
+	if(!source)
+		return;
+	bool active = targets().contains(source); // events of keyboards which are not selected are dropped
+	kontrolEvent event;
+	quint8 changedKnobs = 0;
+	while(source->readEvent(event))
+		{
+		if(!active)
+			continue;
+		if(event.type == kontrolEvent::knobChange)
+			{
+			if(changedKnobs & (1 << event.index))
+				knobChangesCollapsed++;
+			changedKnobs |= 1 << event.index;
+			knobValues[event.index] = event.value;
+			continue;
+			}
+		if(event.type == kontrolEvent::buttonDown)
+			buttonPressed(event.index);
+		}
+	regions.request(regions.region("values", 0), changedKnobs & 0x0f); // encoders 1-4 are on the left screen
+	regions.request(regions.region("values", 1), changedKnobs & 0xf0);
+}
 
-	res = hid_read(handle,buf,91);
+// display tick: a region is due, for the knob values the items are the encoders which changed since the last flush
+void qkontrolWindow::flushRegion(int region, quint32 items)
+{
+	if(regions.name(region) == "values")
+		drawKnobValues(items);
+}
 
-	QByteArray DATA_IN;
-	DATA_IN = QByteArray(reinterpret_cast<char*>(buf), res);
-	if((res == 51) && (DATA_IN[0]==char(0xaa)))
+// show the current values of the changed encoders (one bit per encoder) on the screens
+void qkontrolWindow::drawKnobValues(quint8 knobs)
+{
+	// the values are pre-rendered tiles in the screen format, they go to the encoder as they are. a screen with
+	// a changed encoder gets all its shown values in one transfer, which replaces a waiting one of that screen
+	QList<kontrolDevice *> keyboards = targets();
+	for(int screen=0;screen<2;screen++)
 		{
-		QList<QComboBox *> allModes = tabWidget->findChildren<QComboBox *>(QRegExp("^k_mode_"));
-		QList<int> x, y, dis; // startpoint coordinates and destination display for CC value illustration
-		x << 90 << 108 << 180 << 798 << 90 << 108 << 180 << 798;
-		y << 309 << 309 << 309 << 306 << 309 << 309 << 309 << 306;
-		dis << 0 << 0 << 0 << 0 << 1 << 1 << 1 << 1;
-
-		QPixmap knobValue(32, 18);
-		QPainter *knobPainter = new QPainter(&knobValue);
-		knobPainter->setFont(QFont("Arial", 14, QFont::Bold));
-		knobPainter->setPen(allColors["value"]);
-		knobValue.fill(Qt::black);
+		QList<QImage> tiles;
+		QList<QPoint> positions;
+		bool changed = false;
 		for(int i=0;i<=7;i++)
-			if((findChild<QComboBox *>("k_mode_"+QString::number(8*kontrolPage+i+1))->currentIndex() != 0) && (DATA_IN[17+i*2] != knobsButtons[17+i*2]))
+			if((knobValueScreen[i] == screen) && (findChild<QComboBox *>("k_mode_"+QString::number(8*kontrolPage+i+1))->currentIndex() != 0))
 				{
-				knobValue.fill(Qt::black);
-				knobPainter->drawText(QRect(0, 0, 30, 18), Qt::AlignRight, QString::number(DATA_IN[17+i*2]));
-				drawImage(dis[i], &knobValue, x[i], y[i]);
+				tiles.append(valueTiles.tile(knobValues[i]));
+				positions.append(QPoint(knobValueX[i], knobValueY[i]));
+				changed |= (knobs & (1 << i)) != 0;
 				}
-		knobPainter->end();
-		knobsButtons = DATA_IN;
+		if(!changed)
+			continue;
+		for(kontrolDevice *keyboard : keyboards)
+			keyboard->drawTiles(screen, tiles, positions, valuePriority);
 		}
-	if((res == 32) && (DATA_IN[0]==char(0x01)))
+}
+
+void qkontrolWindow::buttonPressed(int button)
+{
+	switch(button)
 		{
-		if(DATA_IN[2]==char(0x10))
-			qDebug() << "play";
-		if(DATA_IN[3]==char(0x02))
-			qDebug() << "rec";
-		if(DATA_IN[3]==char(0x01))
-			qDebug() << "stop";
-		if(DATA_IN[3]==char(0x10)) // preset up
-			zapPreset(0);
-		if(DATA_IN[3]==char(0x40)) // preset down
-			zapPreset(1);
-		if((DATA_IN[3]==char(0x80)) && kontrolPage > 0)
-			setKontrolpage(kontrolPage-1);
-		if((DATA_IN[3]==char(0x20)) && kontrolPage < 3)
-			setKontrolpage(kontrolPage+1);
+		case buttonPlay: qDebug() << "play"; break;
+		case buttonRec: qDebug() << "rec"; break;
+		case buttonStop: qDebug() << "stop"; break;
+		case buttonPresetUp: zapPreset(0); break;
+		case buttonPresetDown: zapPreset(1); break;
+		case buttonPageLeft: if(kontrolPage > 0) setKontrolpage(kontrolPage-1); break;
+		case buttonPageRight: if(kontrolPage < 3) setKontrolpage(kontrolPage+1); break;
 		}
 }
 
@@ -399,7 +486,12 @@ void qkontrolWindow::setKeyzones()
 	QList<QToolBox *> allSToolboxes = tabWidget->findChildren<QToolBox *>(QRegExp("^s_toolbox"));
 	QList<QxtSpanSlider *> allRanges = tabWidget->findChildren<QxtSpanSlider *>(QRegExp("^s_minmax_"));
 
-	QByteArray mapping, knobsAndButtons, sliders, pedals, port_1, port_2;
+	// everything below is sent as one transaction, the event loop keeps running meanwhile
+	deviceTransaction *apply = new deviceTransaction(targets(), this);
+	connect(apply, SIGNAL(done(deviceTransaction *)), this, SLOT(keyzonesApplied(deviceTransaction *)));
+
+	pageSettings settings = pageSnapshot(); // the page dependent part, also used for prebuilding all pages
+	QByteArray mapping, sliders, pedals, port_1, port_2;
 	QStringList sliderFunctionList;
 	sliderFunctionList << "pitch wheel" << "mod wheel" << "touch strip";
 	mapping.append(QByteArray::fromHex("a4"));
@@ -438,66 +530,10 @@ void qkontrolWindow::setKeyzones()
 		mapping.append(QByteArray::fromHex("0000"));
 		}
 
-	res = hid_write(handle, (unsigned char*) mapping.constData(), mapping.count());
+	apply->addReport("keyzones", mapping);
 
 
-	knobsAndButtons.append(QByteArray::fromHex("a1"));
-	for(unsigned int i=kontrolPage*8;i<=kontrolPage*8+7;i++) // buttons
-		{
-		switch(findChild<QComboBox *>("b_mode_"+QString::number(i+1))->currentIndex())
-		{
-			case 0: knobsAndButtons.append(QByteArray::fromHex("00")); break;
-			case 4: knobsAndButtons.append(QByteArray::fromHex("04")); break;
-			default: knobsAndButtons.append(QByteArray::fromHex("03")); break;
-		}
-		knobsAndButtons.append(findChild<QSpinBox *>("b_CC_"+QString::number(i+1))->value());
-		knobsAndButtons.append(findChild<QSpinBox *>("b_channel_"+QString::number(i+1))->value()-1);
- 		switch(findChild<QComboBox *>("b_mode_"+QString::number(i+1))->currentIndex())
-			{
-			case 1: knobsAndButtons.append(QByteArray::fromHex("3c")); break; // toggle
-			case 3: knobsAndButtons.append(QByteArray::fromHex("3e")); break; // gate
-			default: knobsAndButtons.append(QByteArray::fromHex("3d")); break; // any other
-			}
-		knobsAndButtons.append(QByteArray::fromHex("0000"));
-		if(findChild<QComboBox *>("b_mode_"+QString::number(i+1))->currentIndex()==4)
-			knobsAndButtons.append(findChild<QSpinBox *>("b_CC_"+QString::number(i+1))->value());
-		else
-			knobsAndButtons.append(QByteArray::fromHex("7f"));
-		knobsAndButtons.append(QByteArray::fromHex("0000000000"));
-		}
-	for(unsigned int i=kontrolPage*8;i<=kontrolPage*8+7;i++) // knobs
-		{
-                switch(findChild<QComboBox *>("k_mode_"+QString::number(i+1))->currentIndex())
-                        {
-			case 0: knobsAndButtons.append(QByteArray::fromHex("00")); break;
-			case 1: knobsAndButtons.append(QByteArray::fromHex("04")); break;
-			default: knobsAndButtons.append(QByteArray::fromHex("03")); break;
-                        }
-		knobsAndButtons.append(findChild<QSpinBox *>("k_CC_"+QString::number(i+1))->value());
-		knobsAndButtons.append(findChild<QSpinBox *>("k_channel_"+QString::number(i+1))->value()-1);
-		knobsAndButtons.append(QByteArray::fromHex("3c00007f0000000000"));
-		}
-	for(unsigned int i=kontrolPage*8;i<=kontrolPage*8+7;i++) // background light of the buttons
-		{
-		switch(findChild<QComboBox *>("b_color_"+QString::number(i+1))->currentIndex())
-			{
-			case 0: knobsAndButtons.append(QByteArray::fromHex("00")); break; // off
-			case 1: knobsAndButtons.append(QByteArray::fromHex("1f")); break; // white
-			case 2: knobsAndButtons.append(QByteArray::fromHex("01")); break; // red
-			case 3: knobsAndButtons.append(QByteArray::fromHex("0a")); break; // blue
-			case 4: knobsAndButtons.append(QByteArray::fromHex("03")); break; // orange
-			case 5: knobsAndButtons.append(QByteArray::fromHex("09")); break; // cyan
-			case 6: knobsAndButtons.append(QByteArray::fromHex("07")); break; // green
-			case 7: knobsAndButtons.append(QByteArray::fromHex("0c")); break; // violet
-			case 8: knobsAndButtons.append(QByteArray::fromHex("05")); break; // yellow
-			case 9: knobsAndButtons.append(QByteArray::fromHex("0e")); break; // magenta
-			case 10: knobsAndButtons.append(QByteArray::fromHex("08")); break; // mint
-			case 11: knobsAndButtons.append(QByteArray::fromHex("0d")); break; // purple
-			case 12: knobsAndButtons.append(QByteArray::fromHex("10")); break; // pink
-			}
-		}
-	knobsAndButtons.append(QByteArray::fromHex("000000")); // suffix-data, always the same
-	res = hid_write(handle, (unsigned char*) knobsAndButtons.constData(), knobsAndButtons.count());
+	apply->addReport("knobsAndButtons", pageCache::knobsAndButtons(settings, kontrolPage));
 
 	sliders.append(QByteArray::fromHex("a2"));
 
@@ -544,7 +580,7 @@ void qkontrolWindow::setKeyzones()
 		sliders.append(QByteArray::fromHex("00000000"));
 	sliders.append(QByteArray::fromHex("00000000"));
 
-	res = hid_write(handle, (unsigned char*) sliders.constData(), sliders.count());
+	apply->addReport("sliders", sliders);
 
 	// declare which pedal hardware is connected to the pedal ports (pedals or switches?)
 
@@ -565,7 +601,7 @@ void qkontrolWindow::setKeyzones()
 		port_1.append(QByteArray::fromHex("03"));
 	port_1.append("00000000000000000000000000000000000000000000000000000000");
 
-	res = hid_write(handle, (unsigned char*) port_1.constData(), port_1.count());
+	apply->addReport("pedalPort1", port_1);
 
 	// port 2
 	port_2.append("f4220003");
@@ -584,7 +620,7 @@ void qkontrolWindow::setKeyzones()
                 port_2.append(QByteArray::fromHex("03"));
         port_2.append("00000000000000000000000000000000000000000000000000000000");
 
-	res = hid_write(handle, (unsigned char*) port_2.constData(), port_2.count());
+	apply->addReport("pedalPort2", port_2);
 
 	// transmit the pedal and switch parameters
 
@@ -758,164 +794,192 @@ void qkontrolWindow::setKeyzones()
 		pedals.append(QByteArray::fromHex("00"));
 	pedals.append(QByteArray::fromHex("00"));
 
-	res = hid_write(handle, (unsigned char*) pedals.constData(), pedals.count());
-
-	// print the selected Midi CC numbers on the screens
-	QPixmap screen1(480, 272);
-	QPixmap screen2(480, 272);
-	QPainter *image1 = new QPainter(&screen1);
-	QPainter *image2 = new QPainter(&screen2);
-	QVector<QPainter*> image;
-	image.push_back(image1);
-	image.push_back(image2);
-
-	screen1.fill(Qt::black);
-	screen2.fill(Qt::black);
-
-	if(QFile::exists(graphicsViewScreen1->currentFile))
-		image1->drawImage(0, 65, QImage(graphicsViewScreen1->currentFile).scaled(480, 140));
-	if(QFile::exists(graphicsViewScreen2->currentFile))
-		image2->drawImage(0, 65, QImage(graphicsViewScreen2->currentFile).scaled(480, 140));
-	if(p_ScreenCC->currentIndex() == 1)
-		{
-		image1->setFont(QFont("Arial", 16, QFont::Bold));
-		image1->setPen(allColors["slider"]);
-		image1->drawText(QPoint(30,110), sliderFunctionList[0]);
-		image1->drawText(QPoint(30,140), sliderFunctionList[1]);
-		image1->drawText(QPoint(30,170), sliderFunctionList[2]);
-		image1->drawText(QPoint(370, 140), "page "+QString::number(kontrolPage+1)+"/4");
-		}
-	if(p_ScreenCC->currentIndex() == 2)
+	apply->addReport("pedals", pedals);
+
+	// the screens of the current page are composited on the render pool, the transaction starts when they are done
+	settings.sliderFunctions = sliderFunctionList;
+	renderer.render(settings, kontrolPage, apply);
+
+	// the other pages are built in the background for the page buttons
+	pages.update(settings);
+}
+
+// the widget values the pages depend on
+pageSettings qkontrolWindow::pageSnapshot()
+{
+	pageSettings settings;
+	for(int i=0;i<32;i++)
 		{
-		image2->setFont(QFont("Arial", 16, QFont::Bold));
-		image2->setPen(allColors["slider"]);
-		image2->drawText(QPoint(30,110), sliderFunctionList[0]);
-		image2->drawText(QPoint(30,140), sliderFunctionList[1]);
-		image2->drawText(QPoint(30,170), sliderFunctionList[2]);
-		image2->drawText(QPoint(370, 140), "page "+QString::number(kontrolPage+1)+"/4");
+		controlSettings &c = settings.controls[i];
+		QString number = QString::number(i+1);
+		c.buttonMode = findChild<QComboBox *>("b_mode_"+number)->currentIndex();
+		c.buttonCC = findChild<QSpinBox *>("b_CC_"+number)->value();
+		c.buttonChannel = findChild<QSpinBox *>("b_channel_"+number)->value();
+		c.buttonColor = findChild<QComboBox *>("b_color_"+number)->currentIndex();
+		c.buttonDescription = findChild<QLineEdit *>("b_description_"+number)->text();
+		c.knobMode = findChild<QComboBox *>("k_mode_"+number)->currentIndex();
+		c.knobCC = findChild<QSpinBox *>("k_CC_"+number)->value();
+		c.knobChannel = findChild<QSpinBox *>("k_channel_"+number)->value();
+		c.knobDescription = findChild<QLineEdit *>("k_description_"+number)->text();
 		}
+	settings.sliderScreen = ((p_ScreenCC->currentIndex() == 1) || (p_ScreenCC->currentIndex() == 2)) ? p_ScreenCC->currentIndex()-1 : -1;
+	settings.colors = allColors;
+	settings.backgrounds[0] = backgrounds.scaled(graphicsViewScreen1->currentFile, QSize(480, 140));
+	settings.backgrounds[1] = backgrounds.scaled(graphicsViewScreen2->currentFile, QSize(480, 140));
+	return settings;
+}
 
-	image1->setFont(QFont("Arial", 13, QFont::Bold));
-	image1->setPen(allColors["CC"]);
-	image2->setFont(QFont("Arial", 13, QFont::Bold));
-	image2->setPen(allColors["CC"]);
+// the priority a changed rectangle of a composed screen is sent with, by the part of the layout containing it
+static int layoutPriority(const QRect &rect)
+{
+	if(buttonLabelArea.contains(rect) || knobLabelArea.contains(rect))
+		return labelPriority;
+	if(statusArea.contains(rect))
+		return statusPriority;
+	return backgroundPriority;
+}
 
-	QList<int> y;
-	y << 10 << 130 << 250 << 370 << 10 << 130 << 250 << 370;
+// the display counts pixels in pairs: widen a rectangle of the screen to even columns (the screen width is even)
+static QRect evenColumns(const QRect &rect)
+{
+	QRect even = rect;
+	even.setLeft(rect.left() & ~1);
+	even.setRight(rect.right() | 1);
+	return even;
+}
 
-	for(int i=0;i<=7;i++)
+// the screens of setKeyzones() are composited: the compositors only repainted what differs from the last time.
+// the changed rectangles are queued by the priority of their part of the layout (the labels reach the screens
+// before the background), then the whole screen: a keyboard which does not show it yet gets the rest from it
+void qkontrolWindow::screensRendered(deviceTransaction *apply)
+{
+	for(int screen=0;screen<2;screen++)
 		{
-		switch(findChild<QComboBox *>("b_mode_"+QString::number(8*kontrolPage+i+1))->currentIndex())
+		const QImage &composed = renderer.image(screen);
+		for(const QRect &rect : renderer.changed(screen))
 			{
-			case 0: image[floor(i/4)]->drawText(QRect(y[i], 10, 100, 27), Qt::AlignCenter, "OFF"); break;
-			case 4: image[floor(i/4)]->drawText(QRect(y[i], 10, 100, 27), Qt::AlignCenter, "PRG "+QString::number(findChild<QSpinBox *>("b_CC_"+QString::number(8*kontrolPage+i+1))->value())); break;
-			default: image[floor(i/4)]->drawText(QRect(y[i], 10, 100, 27), Qt::AlignCenter, "CC "+QString::number(findChild<QSpinBox *>("b_CC_"+QString::number(8*kontrolPage+i+1))->value())); break;
+			int priority = layoutPriority(rect);
+			QRect even = evenColumns(rect);
+			if(priority > backgroundPriority)
+				apply->addFrame(screen, composed.copy(even), even.x(), even.y(), priority);
 			}
+		apply->addFrame(screen, composed, 0, 0, backgroundPriority);
 		}
+	apply->start();
+}
 
-	image1->setFont(QFont("Arial", 10));
-	image2->setFont(QFont("Arial", 10));
-
-	for(int i=0;i<=7;i++)
-		switch(findChild<QComboBox *>("k_mode_"+QString::number(8*kontrolPage+i+1))->currentIndex())
-			{
-			case 0: image[floor(i/4)]->drawText(QPoint(y[i], 245), "OFF"); break;
-			case 1: image[floor(i/4)]->drawText(QPoint(y[i], 245), "PRESET"); break;
-			default: image[floor(i/4)]->drawText(QPoint(y[i], 245), "CC "+QString::number(findChild<QSpinBox *>("k_CC_"+QString::number(8*kontrolPage+i+1))->value())); break;
-			}
+// all reports and frames of setKeyzones() reached the keyboards (or failed)
+void qkontrolWindow::keyzonesApplied(deviceTransaction *apply)
+{
+	presetsApplied++;
+	presetLatency += apply->latency();
+	if(!apply->succeeded())
+		{
+		qDebug() << "preset partly failed:" << apply->failures();
+		statusBar()->showMessage("The settings could not be sent completely: "+apply->failures().join(", "), 10000);
+		}
+	apply->deleteLater();
+}
 
-	image1->setFont(QFont("Arial", 9));
-	image2->setFont(QFont("Arial", 9));
 
-	image1->setPen(allColors["parameter"]);
-	image2->setPen(allColors["parameter"]);
+// a display transfer failed even after retrying: the screens are degraded but keyboard and settings keep
+// working, the transfer thread keeps trying in the background and the screens are redrawn once it succeeds
+void qkontrolWindow::displayFailed(int error)
+{
+	kontrolDevice *keyboard = qobject_cast<kontrolDevice *>(sender());
+	QString name = keyboard ? keyboard->name() : QString("Komplete Kontrol");
+	statusBar()->showMessage(name+": USB transmission of the display data failed (libusb error "+QString::number(error)+"), retrying");
+}
 
-	for(int i=0;i<=7;i++)
-		{
-		if(findChild<QComboBox *>("k_mode_"+QString::number(8*kontrolPage+i+1))->currentIndex() == 2)
-			image[floor(i/4)]->drawText(QPoint(y[i], 263), findChild<QLineEdit *>("k_description_"+QString::number(8*kontrolPage+i+1))->text());
-		if(findChild<QComboBox *>("b_mode_"+QString::number(8*kontrolPage+i+1))->currentIndex() != 0)
-			image[floor(i/4)]->drawText(QRect(y[i], 32, 100, 13), Qt::AlignCenter, findChild<QLineEdit *>("b_description_"+QString::number(8*kontrolPage+i+1))->text());
-		}
+void qkontrolWindow::displayRecovered()
+{
+	kontrolDevice *keyboard = qobject_cast<kontrolDevice *>(sender());
+	QString name = keyboard ? keyboard->name() : QString("Komplete Kontrol");
+	statusBar()->showMessage(name+": displays working again", 5000);
+}
 
-	image1->setPen(allColors["divider"]);
-	image2->setPen(allColors["divider"]);
+// measured once per second by the display thread of a keyboard while it sends frames, the savings are
+// the average bytes per drawn frame left out as unchanged (shadow buffers) or as repeat blocks (encoder)
+void qkontrolWindow::showDisplayStatistics(double megabytesPerSecond, double leftFramesPerSecond, double rightFramesPerSecond, double unchangedBytesPerFrame, double repeatedBytesPerFrame)
+{
+	displayThroughput->setText(QString("%1 MB/s, %2 / %3 fps, %4 / %5 kB per frame unchanged / repeated").arg(megabytesPerSecond, 0, 'f', 1).arg(leftFramesPerSecond, 0, 'f', 1).arg(rightFramesPerSecond, 0, 'f', 1).arg(unchangedBytesPerFrame/1024, 0, 'f', 1).arg(repeatedBytesPerFrame/1024, 0, 'f', 1));
+	if(logDisplayStatistics)
+		qDebug() << "display:" << megabytesPerSecond << "MB/s," << leftFramesPerSecond << "/" << rightFramesPerSecond << "full frames per second," << unchangedBytesPerFrame << "bytes per frame unchanged," << repeatedBytesPerFrame << "repeated";
+}
 
-	for(int i=0;i<=7;i++)
-		image[floor(i/4)]->drawRect(y[i], 10, 100, 36);
+// the keyboards which are currently driven: all of them or the one chosen in the selector
+QList<kontrolDevice *> qkontrolWindow::targets() const
+{
+	QList<kontrolDevice *> keyboards = devices.deviceList();
+	int selected = deviceSelector->currentIndex();
+	if((selected <= 0) || (selected > keyboards.count()))
+		return keyboards;
+	return QList<kontrolDevice *>() << keyboards[selected-1];
+}
 
-	image1->drawLine(120, 225, 120, 272);
-	image1->drawLine(240, 225, 240, 272);
-	image1->drawLine(360, 225, 360, 272);
+// send a named HID report to every driven keyboard. the output thread of each keyboard writes it, in
+// order with its other reports, so several keyboards are written concurrently and the GUI never waits
+void qkontrolWindow::writeReport(const QString &name, const QByteArray &report)
+{
+	deviceTransaction *write = new deviceTransaction(targets(), this);
+	connect(write, SIGNAL(done(deviceTransaction *)), this, SLOT(reportWritten(deviceTransaction *)));
+	write->addReport(name, report);
+	write->start();
+}
 
-	image2->drawLine(120, 225, 120, 272);
-	image2->drawLine(240, 225, 240, 272);
-	image2->drawLine(360, 225, 360, 272);
+// a report of writeReport() reached the keyboards or failed on some of them
+void qkontrolWindow::reportWritten(deviceTransaction *write)
+{
+	if(!write->succeeded())
+		statusBar()->showMessage("A report could not be sent: "+write->failures().join(", "), 10000);
+	write->deleteLater();
+}
 
+// a keyboard was seen for the first time, the selector entries follow the order of devices.deviceList()
+void qkontrolWindow::deviceAdded(kontrolDevice *keyboard)
+{
+	connect(keyboard, SIGNAL(eventsAvailable()), this, SLOT(updateValues()));
+	connect(keyboard, SIGNAL(displayError(int)), this, SLOT(displayFailed(int)));
+	connect(keyboard, SIGNAL(displayRecovered()), this, SLOT(displayRecovered()));
+	connect(keyboard, SIGNAL(displayStatistics(double, double, double, double, double)), this, SLOT(showDisplayStatistics(double, double, double, double, double)));
+	deviceSelector->addItem(keyboard->name());
+}
 
-	drawImage(0, &screen1);
-	drawImage(1, &screen2);
+// a keyboard was plugged in (or found at startup): a reconnected one already got its cached settings
+// and screens back, for a new one everything is submitted (unchanged reports and pixels are skipped for the others)
+void qkontrolWindow::deviceAttached(kontrolDevice *keyboard)
+{
+	statusBar()->showMessage(keyboard->name()+" connected", 5000);
+	if(targets().contains(keyboard))
+		{
+		fitLightguide();
+		setButtons();
+		setKeyzones();
+		}
+}
 
-	image1->end();
-	image2->end();
+void qkontrolWindow::deviceDetached(kontrolDevice *keyboard)
+{
+	statusBar()->showMessage(keyboard->name()+" disconnected");
 }
 
+// a different keyboard (or all of them) is driven from now on, bring it up to date
+void qkontrolWindow::selectDevice(int index)
+{
+	Q_UNUSED(index);
+	fitLightguide();
+	setButtons();
+	setKeyzones();
+}
 
-void qkontrolWindow::drawImage(uint8_t screen, QPixmap *pixmap, ushort x, ushort y)
+// the lightguide starts at the leftmost key of the (first) driven keyboard, so scales fall on the right keys
+void qkontrolWindow::fitLightguide()
 {
-	QByteArray tux;
-
-	QImage image = pixmap->toImage();
-	image = image.convertToFormat(QImage::Format_RGB16);
-	ushort *swappedData = reinterpret_cast<ushort *>(image.bits());
-	tux.append(QByteArray::fromHex("8400"));
-	tux.append(screen);
-	tux.append(QByteArray::fromHex("6000000000"));
-	tux.append(QByteArray::fromHex(QByteArray::number(x).rightJustified(4,'0')));
-	tux.append(QByteArray::fromHex(QByteArray::number(y).rightJustified(4,'0')));
-	tux.append(QByteArray::fromHex(QByteArray::number(image.width(),16).rightJustified(4,'0')));
-	tux.append(QByteArray::fromHex(QByteArray::number(image.height(),16).rightJustified(4,'0')));
-
-	tux.append(QByteArray::fromHex("020000000000"));
-	tux.append(QByteArray::fromHex(QByteArray::number(image.width()*image.height()/2,16).rightJustified(4,'0')));
-	for(int i=0;i<(image.width()*image.height());i++)
-		tux.append(QByteArray::fromHex(QByteArray::number(swappedData[i],16).rightJustified(4,'0')));
-	tux.append(QByteArray::fromHex("020000000300000040000000"));
-
-//	libusb_device **devs; //pointer to pointer of device, used to retrieve a list of devices
-        libusb_device_handle *dev_handle; //a device handle
-        libusb_context *ctx = NULL; //a libusb session
-        int r = 0; // any error will lower this value
-//        ssize_t cnt; //holding number of devices in list
-        r -= libusb_init(&ctx); //initialize the library for the session we just declared
-
-//        cnt = libusb_get_device_list(ctx, &devs); //get the list of devices
-//        if(cnt < 0) {
-//                cout<<"Get Device Error"<<endl; //there was an error
-//        }
-//        cout<<cnt<<" Devices in list."<<endl;
-
-	dev_handle = libusb_open_device_with_vid_pid(ctx, 0x17cc, pid); // vendor ID 0x17cc = Native Instruments, product ID was probed at startup
-        if(dev_handle == NULL)
-                cout<<"Cannot open device"<<endl;
-//        libusb_free_device_list(devs, 1); //free the list, unref the devices in it
-
-        int actual; //used to find out how many bytes were written
-//        if(libusb_kernel_driver_active(dev_handle, 0) == 1) { //find out if kernel driver is attached
-//                cout<<"Kernel Driver Active"<<endl;
-//                if(libusb_detach_kernel_driver(dev_handle, 0) == 0) //detach it
-//                        cout<<"Kernel Driver Detached!"<<endl;
-//        }
-        r -= libusb_claim_interface(dev_handle, 3); //claim interface 0 (the first) of device (mine had jsut 1)
-
-	r -= libusb_bulk_transfer(dev_handle, 3, (unsigned char*) tux.constData(), tux.count(), &actual, 0);
-
-        r -= libusb_release_interface(dev_handle, 0); //release the claimed interface
-        if(r<0)
-		QMessageBox::critical(this, "communication error", "The USB transmission of the bitmap data failed. Please restart your Komplete Kontrol device and try again");
-
-        libusb_close(dev_handle); //close the device we opened
-        libusb_exit(ctx); //needs to be called to end the
+	QList<kontrolDevice *> keyboards = targets();
+	if(keyboards.isEmpty())
+		return;
+	guide.keys().setFirstNote(lightguide::firstNoteOf(keyboards[0]->keyCount()));
+	guide.update();
 }
 
 void qkontrolWindow::selectColor(QString target)
@@ -946,10 +1010,24 @@ void qkontrolWindow::updateColors()
 	color_dividers->setIcon(pixmapColors);
 	pixmapColors.fill(allColors["value"]);
 	color_values->setIcon(pixmapColors);
+	valueTiles.setColor(allColors["value"]); // renders the knob values again if their color changed
+	pageWidgetsChanged();
+}
+
+// an edit which was not sent yet: the next page switch sends everything from the widgets and builds the pages again
+void qkontrolWindow::pageWidgetsChanged()
+{
+	pages.invalidate();
 }
 
 qkontrolWindow::~qkontrolWindow()
 {
+	devices.stop();
+	qDebug() << "lightguide:" << guide.sentCount() << "frames sent," << guide.unchangedCount() << "unchanged," << guide.skippedCount() << "skipped for the I/O budget";
+	qDebug() << "input:" << knobChangesCollapsed << "encoder changes collapsed," << regions.mergedCount() << "overlays merged into" << regions.tickCount() << "display ticks," << valueTiles.buildCount() << "value tile sets rendered";
+	qDebug() << "pages:" << pageSwitches << "switches," << slowPageSwitches << "slower than" << pageSwitchTarget << "ms";
+	qDebug() << "presets:" << presetsApplied << "applied in" << (presetsApplied ? presetLatency/qint64(presetsApplied)/1000 : 0) << "us on average";
+	qDebug() << "screens:" << renderer.renderCount() << "renders of" << renderer.averageRenderTime()/1000 << "us on average," << renderer.drawnCount() << "labels drawn," << renderer.reusedCount() << "reused," << renderer.layoutCount() << "texts laid out," << backgrounds.hitCount() << "backgrounds from the cache," << backgrounds.missCount() << "decoded";
 	res = hid_exit();
 }
 
@@ -1044,7 +1122,7 @@ bool qkontrolWindow::save()
 	file.write("\t<LeftBitmap>\n");
 	QByteArray leftBa;
 	QBuffer leftBuffer(&leftBa);
-	QImage(graphicsViewScreen1->currentFile).scaled(480, 140).save(&leftBuffer, "PNG");
+	backgrounds.scaled(graphicsViewScreen1->currentFile, QSize(480, 140), QImage::Format_Invalid).save(&leftBuffer, "PNG"); // full depth, not the RGB565 of the screens
 	file.write(leftBa.toBase64());
 	file.write("\n");
 	file.write("\t</LeftBitmap>\n");
@@ -1052,7 +1130,7 @@ bool qkontrolWindow::save()
 	file.write("\t<RightBitmap>\n");
 	QByteArray rightBa;
 	QBuffer rightBuffer(&rightBa);
-	QImage(graphicsViewScreen2->currentFile).scaled(480, 140).save(&rightBuffer, "PNG");
+	backgrounds.scaled(graphicsViewScreen2->currentFile, QSize(480, 140), QImage::Format_Invalid).save(&rightBuffer, "PNG");
 	file.write(rightBa.toBase64());
 	file.write("\n");
 	file.write("\t</RightBitmap>\n");
@@ -1122,23 +1200,42 @@ void qkontrolWindow::k_setPage(int page)
 void qkontrolWindow::setKontrolpage(unsigned int page)
 	{
 	// switch the button background light depending on the page
-	if(page == 0)
-		lightArray.replace(33,1,QByteArray::fromHex("00"));
-	else
-		lightArray.replace(33,1,QByteArray::fromHex("FF"));
-	if(page == 3)
-		lightArray.replace(34,1,QByteArray::fromHex("00"));
-	else
-		lightArray.replace(34,1,QByteArray::fromHex("FF"));
+	lights.set("pageLeft", page == 0 ? buttonLights::off : buttonLights::on);
+	lights.set("pageRight", page == 3 ? buttonLights::off : buttonLights::on);
 	kontrolPage = page;
+	pageSwitch.start();
 
-	// update the button background lightning
-	setButtons();
-
-	// update key functions and screen information
-	setKeyzones();
+	// update key functions and screen information: a prepared page only needs its knob/button report
+	// and screens, everything else is the same on all pages. while the pages are built everything is sent
+	if(!pages.isReady())
+		{
+		setKeyzones();
+		return;
+		}
+	preparedPage prepared = pages.page(page);
+	deviceTransaction *show = new deviceTransaction(targets(), this);
+	connect(show, SIGNAL(done(deviceTransaction *)), this, SLOT(pageShown(deviceTransaction *)));
+	show->addReport("knobsAndButtons", prepared.report);
+	for(int screen=0;screen<2;screen++)
+		show->addFrame(screen, prepared.screens[screen], 0, 0, labelPriority);
+	show->start();
 	}
 
+// a prepared page reached the keyboards, the latency counts from the page button
+void qkontrolWindow::pageShown(deviceTransaction *show)
+{
+	qint64 latency = pageSwitch.elapsed();
+	pageSwitches++;
+	if(latency > pageSwitchTarget)
+		{
+		slowPageSwitches++;
+		qDebug() << "page" << kontrolPage+1 << "shown after" << latency << "ms, slower than the target of" << pageSwitchTarget << "ms";
+		}
+	if(!show->succeeded())
+		statusBar()->showMessage("The page could not be sent completely: "+show->failures().join(", "), 10000);
+	show->deleteLater();
+}
+
 // when a preset button is clicked, then load another preset file from the same directory if existing
 void qkontrolWindow::zapPreset(bool direction)
 	{
@@ -1161,7 +1258,13 @@ void qkontrolWindow::zapPreset(bool direction)
 // function to toggle the background lightning of the HID buttons
 void qkontrolWindow::setButtons()
 	{
-	res = hid_write(handle, (unsigned char*) lightArray.constData(), lightArray.count());
+	writeReport("buttonLights", lights.report());
+	}
+
+// one rendered lightguide frame, the engine only hands out frames which changed
+void qkontrolWindow::setLightguide(const QByteArray &report)
+	{
+	writeReport("lightguide", report);
 	}
 
 // function to fetch a filename to load
@@ -1201,20 +1304,8 @@ bool qkontrolWindow::load(QString filename)
 	for(unsigned int i=0; i< dirCount; i++)
 		if(QFileInfo(file).fileName() == dirList[i])
 			dirPosition = i;
-	if(dirPosition == 0)
-		lightArray.replace(23,1,QByteArray::fromHex("00"));
-	else
-		lightArray.replace(23,1,QByteArray::fromHex("FF"));
-	if(dirPosition == dirCount-1)
-		lightArray.replace(28,1,QByteArray::fromHex("00"));
-	else
-		lightArray.replace(28,1,QByteArray::fromHex("FF"));
-	if(dirCount < 2)
-		{
-		lightArray.replace(23,1,QByteArray::fromHex("00"));
-		lightArray.replace(28,1,QByteArray::fromHex("00"));
-		}
-	setButtons();
+	lights.set("presetUp", (dirPosition == 0) || (dirCount < 2) ? buttonLights::off : buttonLights::on);
+	lights.set("presetDown", (dirPosition == dirCount-1) || (dirCount < 2) ? buttonLights::off : buttonLights::on);
 
 	// find the root tag (in this case: <qkontrol>)
 	QDomElement root = doc.documentElement();
@@ -1,15 +1,22 @@
 #ifndef _QKONTROLWINDOW_H_
 #define _QKONTROLWINDOW_H_
 
+#include <QComboBox>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QLabel>
 #include <QTemporaryFile>
 #include <QTimer>
-#ifdef Q_OS_MACOS
-#include "/usr/local/Cellar/hidapi/0.9.0/include/hidapi/hidapi.h"
-#else
-#include <hidapi/hidapi.h>
-#endif
 #include "dropgraphicsview.h"
+#include "buttonlights.h"
+#include "devicetransaction.h"
+#include "displayscheduler.h"
+#include "imagecache.h"
+#include "kontroldevicemanager.h"
+#include "lightguide.h"
+#include "pagecache.h"
+#include "screenrenderer.h"
+#include "valueatlas.h"
 #include "ui_qkontrol.h"
 
 class qkontrolWindow : public QMainWindow , protected Ui_mainwindow
@@ -22,14 +29,34 @@ class qkontrolWindow : public QMainWindow , protected Ui_mainwindow
 
 	private:
 		int res;
-		int pid;
 		unsigned int bPage, kPage, kontrolPage, dirCount, dirPosition;
-		hid_device *handle;
-		QByteArray lightArray, knobsButtons;
+		kontrolDeviceManager devices;
+		QComboBox *deviceSelector;
+		QLabel *displayThroughput;
+		bool logDisplayStatistics;
+		displayScheduler regions;
+		screenRenderer renderer;
+		imageCache backgrounds;
+		pageCache pages;
+		QElapsedTimer pageSwitch;
+		static const int pageSwitchTarget = 50; // milliseconds from the page button until both screens show the page
+		quint64 pageSwitches, slowPageSwitches;
+		quint64 knobChangesCollapsed;
+		quint64 presetsApplied;
+		qint64 presetLatency; // nanoseconds, all presets together
+		quint8 knobValues[8];
+		valueAtlas valueTiles;
+		buttonLights lights;
+		lightguideEngine guide;
 		QMap<QString,QColor> allColors;
 		QTemporaryFile leftScreen, rightScreen;
-		QTimer *hid_data;
 		QString getControlName(uint8_t CC);
+		pageSettings pageSnapshot();
+		void drawKnobValues(quint8 knobs);
+		void buttonPressed(int button);
+		QList<kontrolDevice *> targets() const;
+		void writeReport(const QString &name, const QByteArray &report);
+		void fitLightguide();
 		QDir dirName;
 		bool load(QString filename);
 
@@ -38,7 +65,13 @@ class qkontrolWindow : public QMainWindow , protected Ui_mainwindow
 		void getFileName();
 
 	protected slots:
-                void drawImage(uint8_t screen, QPixmap *pixmap, ushort x = 0, ushort y = 0);
+		void displayFailed(int error);
+		void displayRecovered();
+		void showDisplayStatistics(double megabytesPerSecond, double leftFramesPerSecond, double rightFramesPerSecond, double unchangedBytesPerFrame, double repeatedBytesPerFrame);
+		void deviceAdded(kontrolDevice *keyboard);
+		void deviceAttached(kontrolDevice *keyboard);
+		void deviceDetached(kontrolDevice *keyboard);
+		void selectDevice(int index);
 		void b_goLeft();
 		void b_goRight();
 		void b_setPage(int page);
@@ -53,11 +86,18 @@ class qkontrolWindow : public QMainWindow , protected Ui_mainwindow
 		void setParametertextcolor();
 		void setValuetextcolor();
 		void setButtons();
+		void setLightguide(const QByteArray &report);
 		void setKeyzones();
+		void screensRendered(deviceTransaction *apply);
+		void keyzonesApplied(deviceTransaction *apply);
+		void pageShown(deviceTransaction *show);
+		void reportWritten(deviceTransaction *write);
 		void updateValues();
+		void flushRegion(int region, quint32 items);
 		void updateColors();
 		void updatePedalview();
 		void updateWidgets();
+		void pageWidgetsChanged();
 		void zapPreset(bool direction);
 
 	public slots:
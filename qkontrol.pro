@@ -4,11 +4,11 @@ TARGET = qkontrol
 DEPENDPATH += . widgets
 INCLUDEPATH += . widgets
 
-QT += widgets gui testlib xml
+QT += widgets gui testlib xml concurrent
 
 FORMS += qkontrol.ui
-HEADERS += qkontrol.h widgets/qxtstringspinbox.h widgets/qxtspanslider.h widgets/qxtspanslider_p.h dropgraphicsscene.h dropgraphicsview.h
-SOURCES += main.cpp qkontrol.cpp widgets/qxtstringspinbox.cpp widgets/qxtspanslider.cpp dropgraphicsscene.cpp dropgraphicsview.cpp
+HEADERS += qkontrol.h widgets/qxtstringspinbox.h widgets/qxtspanslider.h widgets/qxtspanslider_p.h dropgraphicsscene.h dropgraphicsview.h kontroldisplay.h shadowframebuffer.h displayencoder.h spscring.h hiddecoder.h hidinput.h hidreportcache.h kontroltransport.h usbtransport.h mocktransport.h kontroldevice.h kontroldevicemanager.h hotplugwatcher.h displayscheduler.h buttonlights.h lightguide.h devicetransaction.h screencompositor.h valueatlas.h imagecache.h pagecache.h screenrenderer.h textlayoutcache.h
+SOURCES += main.cpp qkontrol.cpp widgets/qxtstringspinbox.cpp widgets/qxtspanslider.cpp dropgraphicsscene.cpp dropgraphicsview.cpp kontroldisplay.cpp shadowframebuffer.cpp displayencoder.cpp hiddecoder.cpp hidinput.cpp hidreportcache.cpp usbtransport.cpp mocktransport.cpp kontroldevice.cpp kontroldevicemanager.cpp hotplugwatcher.cpp displayscheduler.cpp buttonlights.cpp lightguide.cpp devicetransaction.cpp screencompositor.cpp valueatlas.cpp imagecache.cpp pagecache.cpp screenrenderer.cpp textlayoutcache.cpp
 RESOURCES += qkontrol.qrc
 
 !macx: LIBS += -lhidapi-libusb -lusb-1.0
@@ -0,0 +1,210 @@
+#include <QFontMetrics>
+#include <QPainter>
+#include "screencompositor.h"
+
+bool screenCompositor::item::operator==(const item &other) const
+{
+	return (type == other.type) && (area == other.area) && (position == other.position) && (flags == other.flags) && (maximumWidth == other.maximumWidth) && (caption == other.caption) && (font == other.font) && (color == other.color);
+}
+
+// text with its baseline starting at position
+screenCompositor::item screenCompositor::text(const QPoint &position, const QString &caption, const QFont &font, const QColor &color, int maximumWidth)
+{
+	item i;
+	i.type = item::text;
+	i.position = position;
+	i.flags = 0;
+	i.maximumWidth = maximumWidth;
+	i.caption = caption;
+	i.font = font;
+	i.color = color;
+	return i;
+}
+
+// text aligned inside area (Qt::AlignmentFlag), cut with an ellipsis if it is wider
+screenCompositor::item screenCompositor::text(const QRect &area, int flags, const QString &caption, const QFont &font, const QColor &color)
+{
+	item i = text(QPoint(), caption, font, color, area.width());
+	i.type = item::alignedText;
+	i.area = area;
+	i.flags = flags;
+	return i;
+}
+
+// outline of a rectangle, drawn like QPainter::drawRect()
+screenCompositor::item screenCompositor::box(const QRect &area, const QColor &color)
+{
+	item i = text(QPoint(), QString(), QFont(), color);
+	i.type = item::box;
+	i.area = area;
+	return i;
+}
+
+screenCompositor::item screenCompositor::line(const QPoint &from, const QPoint &to, const QColor &color)
+{
+	item i = text(QPoint(), QString(), QFont(), color);
+	i.type = item::line;
+	i.area = QRect(from, to);
+	return i;
+}
+
+screenCompositor::screenCompositor(int width, int height)
+{
+	background = QImage(width, height, QImage::Format_RGB32);
+	background.fill(Qt::black);
+	labels = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+	labels.fill(Qt::transparent);
+	screen = QImage(width, height, QImage::Format_RGB32);
+	changed = QRegion(screen.rect()); // the first update composites everything
+	backgroundKey = 0;
+	drawn = 0;
+	reused = 0;
+}
+
+// picture (already scaled, e.g. by the imageCache) at area on black, a null image leaves the screen black.
+// the layer is only painted again if it is a different image than last time
+void screenCompositor::setBackground(const QImage &picture, const QRect &area)
+{
+	if((picture.cacheKey() == backgroundKey) && (area == backgroundArea))
+		return;
+
+	changed += backgroundArea;
+	changed += area;
+	background.fill(Qt::black);
+	if(!picture.isNull())
+		{
+		QPainter painter(&background);
+		painter.drawImage(area.topLeft(), picture);
+		}
+	backgroundKey = picture.cacheKey();
+	backgroundArea = area;
+}
+
+// the labels to show after the next update, items are drawn in list order
+void screenCompositor::setLabels(const QList<item> &items)
+{
+	wanted = items;
+}
+
+// bring the layers up to date and composite the changed area into image(), returns that area
+QRegion screenCompositor::update()
+{
+	// labels which disappeared or appeared (moved, other text, other color...) are repainted
+	QRegion repaint;
+	for(const item &i : shown)
+		if(!wanted.contains(i))
+			repaint += bounds(i);
+	for(const item &i : wanted)
+		if(!shown.contains(i))
+			repaint += bounds(i);
+	shown = wanted;
+
+	if(!repaint.isEmpty())
+		{
+		// every item touching the area is drawn again, clipped to it, so overlapping ones stay intact
+		QPainter painter(&labels);
+		painter.setClipRegion(repaint);
+		painter.setCompositionMode(QPainter::CompositionMode_Source);
+		painter.fillRect(labels.rect(), Qt::transparent);
+		painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+		for(const item &i : shown)
+			{
+			if(!repaint.intersects(bounds(i)))
+				{
+				reused++;
+				continue;
+				}
+			drawn++;
+			painter.setPen(i.color);
+			painter.setFont(i.font);
+			switch(i.type)
+				{
+				case item::text:
+				case item::alignedText:
+					{
+					QStaticText layout = texts.layout(i.caption, i.font, i.maximumWidth);
+					painter.drawStaticText(origin(i, layout), layout);
+					}
+					break;
+				case item::box: painter.drawRect(i.area); break;
+				case item::line: painter.drawLine(i.area.topLeft(), i.area.bottomRight()); break;
+				}
+			}
+		changed += repaint;
+		}
+	else
+		reused += shown.count();
+
+	QRegion area = changed.intersected(screen.rect());
+	changed = QRegion();
+	if(!area.isEmpty())
+		{
+		QPainter painter(&screen);
+		painter.setClipRegion(area);
+		painter.setCompositionMode(QPainter::CompositionMode_Source);
+		painter.drawImage(0, 0, background);
+		painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+		painter.drawImage(0, 0, labels);
+		}
+	return area;
+}
+
+// the composited screen
+const QImage &screenCompositor::image() const
+{
+	return screen;
+}
+
+// label items rasterized again
+quint64 screenCompositor::drawnCount() const
+{
+	return drawn;
+}
+
+// label items taken from the layer without drawing them
+quint64 screenCompositor::reusedCount() const
+{
+	return reused;
+}
+
+// texts laid out from the cache (shaping and eliding happen once per text and font)
+quint64 screenCompositor::layoutCount() const
+{
+	return texts.missCount();
+}
+
+// top left corner of a text layout: a text item is positioned by its baseline, an aligned one inside its area
+QPoint screenCompositor::origin(const item &i, const QStaticText &layout)
+{
+	if(i.type == item::text)
+		return i.position-QPoint(0, QFontMetrics(i.font, &labels).ascent());
+	QSize size = layout.size().toSize();
+	int x = i.area.x();
+	int y = i.area.y();
+	if(i.flags & Qt::AlignRight)
+		x = i.area.right()+1-size.width();
+	else if(i.flags & Qt::AlignHCenter)
+		x = i.area.x()+(i.area.width()-size.width())/2;
+	if(i.flags & Qt::AlignBottom)
+		y = i.area.bottom()+1-size.height();
+	else if(i.flags & Qt::AlignVCenter)
+		y = i.area.y()+(i.area.height()-size.height())/2;
+	return QPoint(x, y);
+}
+
+// the pixels an item can touch, with a margin for antialiasing and glyph overhangs
+QRect screenCompositor::bounds(const item &i)
+{
+	switch(i.type)
+		{
+		case item::text:
+		case item::alignedText:
+			{
+			QStaticText layout = texts.layout(i.caption, i.font, i.maximumWidth);
+			return QRect(origin(i, layout), layout.size().toSize()).adjusted(-2, -2, 2, 2);
+			}
+		case item::box: return i.area.adjusted(-1, -1, 2, 2);
+		case item::line: return QRect(i.area.topLeft(), i.area.bottomRight()).normalized().adjusted(-1, -1, 2, 2);
+		}
+	return QRect();
+}
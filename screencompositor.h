@@ -0,0 +1,63 @@
+#ifndef _SCREENCOMPOSITOR_H_
+#define _SCREENCOMPOSITOR_H_
+
+#include <QColor>
+#include <QFont>
+#include <QImage>
+#include <QList>
+#include <QPoint>
+#include <QRect>
+#include <QRegion>
+#include <QStaticText>
+#include <QString>
+#include "textlayoutcache.h"
+
+// retained content of one screen in two cached layers: the background picture and the labels
+// (texts, boxes and lines) on top of it. the labels are described as a list of items on every
+// update, only the items which differ from the last list are rasterized again and only the area
+// they cover is composited, so a page switch or a new color costs a few small repaints
+class screenCompositor
+{
+	public:
+		struct item
+			{
+			enum kind { text, alignedText, box, line };
+			kind type;
+			QRect area; // alignedText and box, a line goes from topLeft() to bottomRight()
+			QPoint position; // baseline of text
+			int flags;
+			int maximumWidth; // of the text in pixels, longer ones end with an ellipsis. 0: no limit
+			QString caption;
+			QFont font;
+			QColor color;
+			bool operator==(const item &other) const;
+			};
+
+		static item text(const QPoint &position, const QString &caption, const QFont &font, const QColor &color, int maximumWidth = 0);
+		static item text(const QRect &area, int flags, const QString &caption, const QFont &font, const QColor &color);
+		static item box(const QRect &area, const QColor &color);
+		static item line(const QPoint &from, const QPoint &to, const QColor &color);
+
+		screenCompositor(int width = 480, int height = 272);
+		void setBackground(const QImage &picture, const QRect &area);
+		void setLabels(const QList<item> &items);
+		QRegion update();
+		const QImage &image() const;
+		quint64 drawnCount() const;
+		quint64 reusedCount() const;
+		quint64 layoutCount() const;
+
+	private:
+		QRect bounds(const item &i);
+		QPoint origin(const item &i, const QStaticText &layout);
+
+		QImage background, labels, screen;
+		qint64 backgroundKey; // QImage::cacheKey() of the picture
+		QRect backgroundArea;
+		QList<item> shown, wanted; // label items in the layer and for the next update
+		QRegion changed; // since the last update
+		textLayoutCache texts;
+		quint64 drawn, reused;
+};
+
+#endif /*_SCREENCOMPOSITOR_H_*/
@@ -0,0 +1,107 @@
+#include <QtConcurrentRun>
+#include "screenrenderer.h"
+
+screenRenderer::screenRenderer(QObject *parent) : QObject(parent)
+{
+	running = 0;
+	lastTime = 0;
+	totalTime = 0;
+	renders = 0;
+	pool.setMaxThreadCount(2); // one per screen
+	for(int screen=0;screen<2;screen++)
+		connect(&watchers[screen], SIGNAL(finished()), this, SLOT(screenDone()));
+}
+
+// queue the screens of a page, rendered() follows when both are composited
+void screenRenderer::render(const pageSettings &settings, int page, deviceTransaction *transaction)
+{
+	job j;
+	j.settings = settings;
+	j.page = page;
+	j.transaction = transaction;
+	jobs.append(j);
+	if(!running)
+		startNext();
+}
+
+// the composited screen of the job rendered() reports
+const QImage &screenRenderer::image(int screen) const
+{
+	return compositor[screen].image();
+}
+
+// the rectangles of image() which differ from the job before
+QVector<QRect> screenRenderer::changed(int screen) const
+{
+	return results[screen];
+}
+
+// wall time of the last job in nanoseconds
+qint64 screenRenderer::renderTime() const
+{
+	return lastTime;
+}
+
+// jobs rendered so far
+quint64 screenRenderer::renderCount() const
+{
+	return renders;
+}
+
+// wall time of a job in nanoseconds, averaged over all of them
+qint64 screenRenderer::averageRenderTime() const
+{
+	return renders ? totalTime/qint64(renders) : 0;
+}
+
+quint64 screenRenderer::drawnCount() const
+{
+	return compositor[0].drawnCount()+compositor[1].drawnCount();
+}
+
+quint64 screenRenderer::reusedCount() const
+{
+	return compositor[0].reusedCount()+compositor[1].reusedCount();
+}
+
+quint64 screenRenderer::layoutCount() const
+{
+	return compositor[0].layoutCount()+compositor[1].layoutCount();
+}
+
+void screenRenderer::startNext()
+{
+	const job &next = jobs.first();
+	clock.start();
+	running = 2;
+	for(int screen=0;screen<2;screen++)
+		watchers[screen].setFuture(QtConcurrent::run(&pool, this, &screenRenderer::compose, screen, next.settings, next.page));
+}
+
+// pool thread: each screen has its own compositor, the two never share anything
+QVector<QRect> screenRenderer::compose(int screen, const pageSettings &settings, int page)
+{
+	compositor[screen].setBackground(settings.backgrounds[screen], QRect(0, 65, 480, 140));
+	compositor[screen].setLabels(pageCache::labels(settings, page, screen));
+	return compositor[screen].update().rects();
+}
+
+void screenRenderer::screenDone()
+{
+	if(--running > 0)
+		return;
+	lastTime = clock.nsecsElapsed();
+	totalTime += lastTime;
+	renders++;
+	for(int screen=0;screen<2;screen++)
+		results[screen] = watchers[screen].result();
+	job done = jobs.takeFirst();
+	emit rendered(done.transaction); // may queue (and start) the next job itself
+	if(!running && !jobs.isEmpty())
+		startNext();
+}
+
+screenRenderer::~screenRenderer()
+{
+	pool.waitForDone();
+}
@@ -0,0 +1,67 @@
+#ifndef _SCREENRENDERER_H_
+#define _SCREENRENDERER_H_
+
+#include <QtGlobal>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QRect>
+#include <QThreadPool>
+#include <QVector>
+#include "pagecache.h"
+#include "screencompositor.h"
+
+class deviceTransaction;
+
+// composites both screens at the same time on a pool of two threads. the GUI thread only hands over
+// a settings snapshot and gets rendered() back, image() and changed() are valid until it returns.
+// jobs are rendered one after another in the order they were given, the transaction of a job just
+// travels along so the caller knows which frames belong where
+class screenRenderer : public QObject
+{
+	Q_OBJECT
+
+	public:
+		explicit screenRenderer(QObject *parent = 0);
+		~screenRenderer();
+		void render(const pageSettings &settings, int page, deviceTransaction *transaction);
+		const QImage &image(int screen) const;
+		QVector<QRect> changed(int screen) const;
+		qint64 renderTime() const;
+		quint64 renderCount() const;
+		qint64 averageRenderTime() const;
+		quint64 drawnCount() const;
+		quint64 reusedCount() const;
+		quint64 layoutCount() const;
+
+	signals:
+		void rendered(deviceTransaction *transaction);
+
+	private slots:
+		void screenDone();
+
+	private:
+		struct job
+			{
+			pageSettings settings;
+			int page;
+			deviceTransaction *transaction;
+			};
+
+		void startNext();
+		QVector<QRect> compose(int screen, const pageSettings &settings, int page);
+
+		screenCompositor compositor[2]; // only touched by the pool while a job runs
+		QThreadPool pool;
+		QFutureWatcher<QVector<QRect> > watchers[2];
+		QVector<QRect> results[2];
+		QList<job> jobs; // the first one is running
+		int running; // screens of the current job not done yet, 0 while idle
+		QElapsedTimer clock;
+		qint64 lastTime, totalTime; // nanoseconds
+		quint64 renders;
+};
+
+#endif /*_SCREENRENDERER_H_*/
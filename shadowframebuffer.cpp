@@ -0,0 +1,112 @@
+#include <string.h>
+#include "shadowframebuffer.h"
+
+shadowFramebuffer::shadowFramebuffer(int width, int height, int tileSize)
+{
+	pixels = QImage(width, height, QImage::Format_RGB16);
+	pixels.fill(0);
+	tile = tileSize;
+	valid = false;
+}
+
+// store a frame which is drawn at x/y and return the screen rectangles (in screen coordinates)
+// which differ from the previous content; an unchanged frame returns an empty list. a frame
+// reaching past the screen is sent completely, only its visible part is mirrored
+QList<QRect> shadowFramebuffer::update(const QImage &frame, int x, int y)
+{
+	QImage source = frame;
+	if(source.format() != QImage::Format_RGB16)
+		source = source.convertToFormat(QImage::Format_RGB16);
+	QRect area(x, y, source.width(), source.height());
+	QList<QRect> dirty;
+
+	QRect visible = area.intersected(pixels.rect());
+
+	if(visible != area)
+		{
+		dirty.append(area);
+		if(visible == pixels.rect())
+			valid = true;
+		}
+	else if(valid)
+		{
+		// collect runs of changed tiles per tile row and join runs with the same span in consecutive rows
+		QList<QRect> open;
+		for(int ty=area.top()/tile; ty<=area.bottom()/tile; ty++)
+			{
+			QList<QRect> runs;
+			for(int tx=area.left()/tile; tx<=area.right()/tile; tx++)
+				{
+				QRect cell = QRect(tx*tile, ty*tile, tile, tile).intersected(area);
+				bool changed = false;
+				for(int row=cell.top(); (row<=cell.bottom()) && !changed; row++)
+					changed = memcmp(pixels.constScanLine(row)+cell.left()*2, source.constScanLine(row-y)+(cell.left()-x)*2, cell.width()*2) != 0;
+				if(!changed)
+					continue;
+				if(!runs.isEmpty() && (runs.last().right()+1 == cell.left()))
+					runs.last().setRight(cell.right());
+				else
+					runs.append(cell);
+				}
+
+			QList<QRect> next;
+			for(const QRect &run : runs)
+				{
+				QRect joined = run;
+				for(int i=0;i<open.count();i++)
+					if((open[i].left() == run.left()) && (open[i].right() == run.right()))
+						{
+						joined.setTop(open[i].top());
+						open.removeAt(i);
+						break;
+						}
+				next.append(joined);
+				}
+			dirty.append(open); // these rectangles don't continue into this tile row
+			open = next;
+			}
+		dirty.append(open);
+		}
+	else
+		{
+		dirty.append(area);
+		// only a full frame tells us the complete screen content again
+		if(area == pixels.rect())
+			valid = true;
+		}
+
+	// the display counts pixels in pairs: widen rectangles with an odd number of pixels inside the frame
+	for(QRect &rect : dirty)
+		if((rect.width()*rect.height()) % 2)
+			{
+			if(rect.right() < area.right())
+				rect.setRight(rect.right()+1);
+			else if(rect.left() > area.left())
+				rect.setLeft(rect.left()-1);
+			else if(rect.bottom() < area.bottom())
+				rect.setBottom(rect.bottom()+1);
+			else if(rect.top() > area.top())
+				rect.setTop(rect.top()-1);
+			}
+
+	for(int row=visible.top(); row<=visible.bottom(); row++)
+		memcpy(pixels.scanLine(row)+visible.left()*2, source.constScanLine(row-y)+(visible.left()-x)*2, visible.width()*2);
+	return dirty;
+}
+
+// forget the mirrored content, the next full frame is sent completely
+void shadowFramebuffer::invalidate()
+{
+	valid = false;
+}
+
+bool shadowFramebuffer::isValid() const
+{
+	return valid;
+}
+
+// the pixels the screen shows, only meaningful while isValid()
+const QImage &shadowFramebuffer::image() const
+{
+	return pixels;
+}
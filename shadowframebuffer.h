@@ -0,0 +1,25 @@
+#ifndef _SHADOWFRAMEBUFFER_H_
+#define _SHADOWFRAMEBUFFER_H_
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+
+// mirror of the RGB565 pixels one screen currently shows, new frames are compared
+// against it tile by tile so only the changed rectangles need to be transmitted
+class shadowFramebuffer
+{
+	public:
+		shadowFramebuffer(int width = 480, int height = 272, int tileSize = 16);
+		QList<QRect> update(const QImage &frame, int x = 0, int y = 0);
+		void invalidate();
+		bool isValid() const;
+		const QImage &image() const;
+
+	private:
+		QImage pixels;
+		int tile;
+		bool valid;
+};
+
+#endif /*_SHADOWFRAMEBUFFER_H_*/
@@ -0,0 +1,48 @@
+#ifndef _SPSCRING_H_
+#define _SPSCRING_H_
+
+#include <QAtomicInt>
+
+// lock-free ring buffer for exactly one producer thread and one consumer thread,
+// Size must be a power of two; one slot stays free to tell a full ring from an empty one
+template <typename T, int Size>
+class spscRing
+{
+	public:
+		spscRing() : head(0), tail(0) {}
+
+		// producer side, returns false if the ring is full
+		bool push(const T &item)
+			{
+			const int h = head.loadAcquire();
+			const int next = (h + 1) & (Size - 1);
+			if(next == tail.loadAcquire())
+				return false;
+			items[h] = item;
+			head.storeRelease(next);
+			return true;
+			}
+
+		// consumer side, returns false if the ring is empty
+		bool pop(T &item)
+			{
+			const int t = tail.loadAcquire();
+			if(t == head.loadAcquire())
+				return false;
+			item = items[t];
+			tail.storeRelease((t + 1) & (Size - 1));
+			return true;
+			}
+
+		// number of queued items, exact only when called from the consumer or producer thread
+		int count() const
+			{
+			return (head.loadAcquire() - tail.loadAcquire()) & (Size - 1);
+			}
+
+	private:
+		T items[Size];
+		QAtomicInt head, tail;
+};
+
+#endif /*_SPSCRING_H_*/
@@ -0,0 +1,42 @@
+#include <QFontMetrics>
+#include <QTransform>
+#include "textlayoutcache.h"
+
+textLayoutCache::textLayoutCache(int limit)
+{
+	capacity = qMax(1, limit);
+	hits = 0;
+	misses = 0;
+}
+
+// text in one line, cut with an ellipsis if it is wider than maximumWidth pixels (0: never cut)
+QStaticText textLayoutCache::layout(const QString &text, const QFont &font, int maximumWidth)
+{
+	QString key = font.key()+"\n"+QString::number(maximumWidth)+"\n"+text;
+	QHash<QString, QStaticText>::iterator found = layouts.find(key);
+	if(found != layouts.end())
+		{
+		hits++;
+		return found.value();
+		}
+
+	misses++;
+	if(layouts.count() >= capacity)
+		layouts.clear(); // the labels of a few presets fit easily, a full cache is mostly stale
+	QStaticText layout(maximumWidth > 0 ? QFontMetrics(font).elidedText(text, Qt::ElideRight, maximumWidth) : text);
+	layout.setTextFormat(Qt::PlainText);
+	layout.setPerformanceHint(QStaticText::AggressiveCaching);
+	layout.prepare(QTransform(), font);
+	layouts.insert(key, layout);
+	return layout;
+}
+
+quint64 textLayoutCache::hitCount() const
+{
+	return hits;
+}
+
+quint64 textLayoutCache::missCount() const
+{
+	return misses;
+}
@@ -0,0 +1,28 @@
+#ifndef _TEXTLAYOUTCACHE_H_
+#define _TEXTLAYOUTCACHE_H_
+
+#include <QtGlobal>
+#include <QFont>
+#include <QHash>
+#include <QStaticText>
+#include <QString>
+
+// laid out (font matched, shaped and elided) texts for drawStaticText(), so a label which shows
+// up again is not shaped again. a layout does not depend on the color, the pen is applied when
+// drawing. the cache is dropped when it holds more than limit layouts. not thread safe, every
+// compositor has its own
+class textLayoutCache
+{
+	public:
+		explicit textLayoutCache(int limit = 512);
+		QStaticText layout(const QString &text, const QFont &font, int maximumWidth = 0);
+		quint64 hitCount() const;
+		quint64 missCount() const;
+
+	private:
+		QHash<QString, QStaticText> layouts;
+		int capacity;
+		quint64 hits, misses;
+};
+
+#endif /*_TEXTLAYOUTCACHE_H_*/
@@ -0,0 +1,13 @@
+#ifndef _CHECKS_H_
+#define _CHECKS_H_
+
+#include <QStringList>
+
+// every check takes the remaining command line and returns the exit code, 0 if it passed
+int displayRate(const QStringList &arguments);
+int pixelKernels(const QStringList &arguments);
+int rleRoundTrip(const QStringList &arguments);
+int decoderFuzz(const QStringList &arguments);
+int lightguideReports(const QStringList &arguments);
+
+#endif /*_CHECKS_H_*/
@@ -0,0 +1,94 @@
+#include <string.h>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include "hiddecoder.h"
+#include "checks.h"
+
+// random input reports through the decoder: mostly well-formed 0x01 and 0xaa reports, the rest of random id and
+// length. after every report the state has to match the report bytes, the events have to turn the previous
+// state into the new one and nothing past the returned events may be written
+int decoderFuzz(const QStringList &arguments)
+{
+	QTextStream out(stdout);
+	int reports = 1000000;
+	for(const QString &argument : arguments)
+		if(argument.toInt() > 0)
+			reports = argument.toInt();
+
+	hidDecoder decoder;
+	kontrolState expected;
+	memset(&expected, 0, sizeof(expected));
+	kontrolEvent events[hidDecoder::maxEvents+8];
+	unsigned char report[128];
+	quint32 seed = 1;
+	int failed = 0;
+	qint64 eventCount = 0;
+	QElapsedTimer timer;
+	timer.start();
+	int n;
+	for(n=0; (n<reports) && (failed<10); n++)
+		{
+		int length;
+		seed = seed*1664525+1013904223;
+		switch((seed >> 24) % 4)
+			{
+			case 0: length = 32; report[0] = 0x01; break;
+			case 1: length = 51; report[0] = 0xaa; break;
+			default: length = (seed >> 8) % sizeof(report); report[0] = seed >> 16; break;
+			}
+		for(int i=1;i<length;i++)
+			{
+			seed = seed*1664525+1013904223;
+			report[i] = (seed >> 28) ? report[i] : (seed >> 16); // few bytes change, like a real keyboard
+			}
+		memset(events, 0xcd, sizeof(events));
+
+		kontrolState before = decoder.state();
+		int count = decoder.decode(report, length, events);
+
+		// what the report says
+		if((length == 32) && (report[0] == 0x01))
+			{
+			expected.buttons = 0;
+			for(int i=0;i<8;i++)
+				expected.buttons |= quint64(report[1+i]) << (8*i);
+			}
+		if((length == 51) && (report[0] == 0xaa))
+			for(int i=0;i<8;i++)
+				expected.knobs[i] = report[17+i*2];
+
+		// what the events say
+		kontrolState replayed = before;
+		bool valid = (count >= 0) && (count <= hidDecoder::maxEvents);
+		for(int i=0; valid && (i<count); i++)
+			{
+			const kontrolEvent &e = events[i];
+			if(e.type == kontrolEvent::knobChange)
+				{
+				valid = (e.index < 8) && (e.delta == qint16(e.value)-replayed.knobs[e.index]) && (e.value != replayed.knobs[e.index]);
+				if(valid)
+					replayed.knobs[e.index] = e.value;
+				}
+			else
+				{
+				const quint64 bit = quint64(1) << (e.index & 63);
+				valid = (e.index < 64) && (((replayed.buttons & bit) != 0) == (e.type == kontrolEvent::buttonUp));
+				replayed.buttons ^= bit;
+				}
+			}
+		for(int i=qMax(0, count); valid && (i<hidDecoder::maxEvents+8); i++)
+			valid = reinterpret_cast<const unsigned char *>(&events[i])[0] == 0xcd;
+
+		const kontrolState &state = decoder.state();
+		if(!valid || (state.buttons != expected.buttons) || memcmp(state.knobs, expected.knobs, sizeof(state.knobs))
+			|| (replayed.buttons != state.buttons) || memcmp(replayed.knobs, state.knobs, sizeof(state.knobs)))
+			{
+			out << "fuzz: report " << n << " (id " << report[0] << ", " << length << " bytes) decoded wrongly, " << count << " events\n";
+			failed++;
+			}
+		eventCount += qMax(0, count);
+		}
+	double seconds = qMax<qint64>(1, timer.nsecsElapsed())/1e9;
+	out << "fuzz: " << n << " reports, " << eventCount << " events, " << failed << " failures, " << qRound(n/seconds) << " reports/s (with the checks)\n";
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QSemaphore>
+#include <QTextStream>
+#include "displayencoder.h"
+#include "kontroldisplay.h"
+#include "mocktransport.h"
+#include "usbtransport.h"
+#include "checks.h"
+
+// full screens of noise for both screens in turn, encoded up front so only the transfer path is measured
+// (noise has no runs, every frame is sent as literal pixels)
+static QList<QByteArray> noiseFrames(int count)
+{
+	QList<QByteArray> frames;
+	quint32 seed = 1;
+	for(int i=0;i<count;i++)
+		{
+		QImage image(480, 272, QImage::Format_RGB16);
+		for(int y=0;y<image.height();y++)
+			{
+			ushort *line = reinterpret_cast<ushort *>(image.scanLine(y));
+			for(int x=0;x<image.width();x++)
+				{
+				seed = seed*1664525+1013904223;
+				line[x] = seed >> 16;
+				}
+			}
+		QByteArray frame(displayEncoder::frameSize(image.width(), image.height()), Qt::Uninitialized);
+		frame.resize(displayEncoder::encode(reinterpret_cast<uchar *>(frame.data()), i % 2, image, 0, 0));
+		frames.append(frame);
+		}
+	return frames;
+}
+
+// frames per second of the display path. "reopened" claims and releases the display for every frame on
+// the calling thread like drawImage() did before, "session" queues the frames to one kontrolDisplay which
+// keeps the display claimed. the stand-in transport takes attachLatency for every claim, like a keyboard
+// does, and the session has to claim it only once for all frames. --keyboard runs the same against the
+// first connected keyboard
+static const int attachLatency = 2; // milliseconds
+
+int displayRate(const QStringList &arguments)
+{
+	QTextStream out(stdout);
+	int count = 500;
+	for(const QString &argument : arguments)
+		if(argument.toInt() > 0)
+			count = argument.toInt();
+
+	kontrolTransport *transport;
+	mockTransport *mock = NULL;
+	if(arguments.contains("--keyboard"))
+		transport = new usbTransport();
+	else
+		{
+		mock = new mockTransport();
+		mock->setRecording(false);
+		mock->setAttachLatency(attachLatency);
+		transport = mock;
+		}
+	if(!transport->open())
+		{
+		QTextStream(stderr) << "rate: no keyboard found\n";
+		delete transport;
+		return 1;
+		}
+	const QList<QByteArray> frames = noiseFrames(16);
+
+	int failed = 0;
+	QElapsedTimer timer;
+	timer.start();
+	for(int i=0;i<count;i++)
+		{
+		const QByteArray &frame = frames[i % frames.count()];
+		int r = LIBUSB_ERROR_NO_DEVICE;
+		if(transport->attachDisplay())
+			{
+			r = transport->writeDisplay(i, reinterpret_cast<const unsigned char *>(frame.constData()), frame.count(), 1000);
+			if(r >= 0)
+				r = transport->flushDisplay(); // a streaming transport may still have it in flight
+			transport->displayResults();
+			}
+		transport->detachDisplay();
+		if(r < 0)
+			failed++;
+		}
+	double reopened = count*1000.0/qMax<qint64>(1, timer.elapsed());
+	int attaches = mock ? mock->attachCount() : 0;
+
+	// two frames in flight, always for different screens, so none replaces the other in the queue
+	kontrolDisplay display;
+	QSemaphore room(2);
+	QAtomicInt errors(0);
+	QObject::connect(&display, &kontrolDisplay::frameSent, &display, [&](quint64, int result)
+		{
+		if(result < 0)
+			errors.ref();
+		room.release();
+		}, Qt::DirectConnection);
+	display.open(transport);
+	timer.restart();
+	for(int i=0;i<count;i++)
+		{
+		room.acquire();
+		display.queue(i % 2, 0, 0, 480, 272, frames[i % frames.count()]);
+		}
+	room.acquire(2);
+	double session = count*1000.0/qMax<qint64>(1, timer.elapsed());
+	int sessionAttaches = mock ? mock->attachCount()-attaches : 0;
+	display.close();
+	transport->close();
+	delete transport;
+	failed += errors.load();
+
+	out << "rate: " << count << " frames of 480x272 (" << frames.first().count() << " bytes) to " << (arguments.contains("--keyboard") ? "the keyboard" : "the stand-in transport") << "\n";
+	out << "rate: reopened for every frame " << qRound(reopened) << " fps, one session " << qRound(session) << " fps\n";
+	if(failed)
+		out << "rate: " << failed << " frames failed\n";
+	if(mock)
+		{
+		// the claim of every frame has to be gone from the session path, not just be cheap
+		out << "rate: the display was attached " << attaches << " times reopened and " << sessionAttaches << " time(s) in the session, " << attachLatency << " ms each\n";
+		if(sessionAttaches != 1)
+			{
+			out << "rate: the session attached the display " << sessionAttaches << " times instead of once\n";
+			failed++;
+			}
+		}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,16 @@
+# measurements and checks of the keyboard I/O paths, built separately: qmake && make in this directory
+CONFIG += console release
+CONFIG -= app_bundle
+TEMPLATE += app
+TARGET = kontrolcheck
+DEPENDPATH += . ../..
+INCLUDEPATH += . ../..
+
+QT += gui
+
+HEADERS += checks.h ../../kontroltransport.h ../../usbtransport.h ../../mocktransport.h ../../kontroldisplay.h ../../displayencoder.h ../../hiddecoder.h ../../lightguide.h
+SOURCES += main.cpp displayrate.cpp pixelkernels.cpp roundtrip.cpp decoderfuzz.cpp ../../hiddecoder.cpp ../../usbtransport.cpp ../../mocktransport.cpp ../../kontroldisplay.cpp ../../displayencoder.cpp lightguidereport.cpp ../../lightguide.cpp
+
+!macx: LIBS += -lhidapi-libusb -lusb-1.0
+
+macx: LIBS += -L/usr/local/Cellar/hidapi/0.9.0/lib/ -lhidapi -L/usr/local/Cellar/libusb/1.0.22/lib/ -lusb-1.0
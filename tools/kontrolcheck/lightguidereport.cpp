@@ -0,0 +1,91 @@
+#include <QByteArray>
+#include <QTextStream>
+#include "lightguide.h"
+#include "mocktransport.h"
+#include "usbtransport.h"
+#include "checks.h"
+
+// the last report the stand-in recorded, empty if there is none
+static QByteArray lastReport(const mockTransport &keyboard)
+{
+	QList<transportRecord> records = keyboard.records();
+	for(int i=records.count()-1;i>=0;i--)
+		if(records[i].type == transportRecord::report)
+			return records[i].data;
+	return QByteArray();
+}
+
+// one lightguide frame written like the output thread does it, compared byte by byte with the expected 0x81 report
+static bool sendAndCompare(mockTransport &keyboard, const QByteArray &frame, const QByteArray &expected, const QString &what, QTextStream &out)
+{
+	keyboard.writeReport(reinterpret_cast<const unsigned char *>(frame.constData()), frame.count());
+	QByteArray sent = lastReport(keyboard);
+	if(sent == expected)
+		return true;
+	if(sent.count() != expected.count())
+		{
+		out << "lightguide: " << what << ": " << sent.count() << " bytes instead of " << expected.count() << "\n";
+		return false;
+		}
+	for(int i=0;i<sent.count();i++)
+		if(sent[i] != expected[i])
+			{
+			out << "lightguide: " << what << ": byte " << i << " is " << QString::number(quint8(sent[i]), 16) << " instead of " << QString::number(quint8(expected[i]), 16) << "\n";
+			break;
+			}
+	return false;
+}
+
+// a C major scale on every model and a chase over time, rendered for the product ID of the stand-in and sent
+// through it. the leftmost key has to be the note of the model (48 for 49 keys, 36 for 61, 21 for 88 and unknown
+// ones) and every key byte of the 0x81 reports has to have the color and brightness the animation gives it
+int lightguideReports(const QStringList &arguments)
+{
+	Q_UNUSED(arguments);
+	QTextStream out(stdout);
+	int failed = 0, reports = 0;
+
+	static const int models[4][2] = { { 0x1610, 48 }, { 0x1620, 36 }, { 0x1630, 21 }, { 0, 21 } };
+	static const bool major[12] = { true, false, true, false, true, true, false, true, false, true, false, true };
+	for(int m=0;m<4;m++)
+		{
+		mockTransport keyboard;
+		keyboard.setProductId(models[m][0]);
+		keyboard.open();
+		lightguide keys(lightguide::firstNoteOf(usbTransport::keyCount(keyboard.productId())));
+		keys.addScale(0, 0xab5, lightguide::green);
+
+		QByteArray expected(1+lightguide::maxKeys, '\0');
+		expected[0] = 0x81;
+		for(int key=0;key<lightguide::maxKeys;key++)
+			expected[1+key] = major[(models[m][1]+key)%12] ? lightguide::green : lightguide::black;
+		if(!sendAndCompare(keyboard, keys.frame(0), expected, "scale on product " + QString::number(models[m][0], 16), out))
+			failed++;
+		reports++;
+		keyboard.close();
+		}
+
+	// 24 keys per second with a tail of 8 keys at full, full, 3/4 ... down to the dimmest level, wrapping at the top
+	mockTransport keyboard;
+	keyboard.setProductId(0x1630);
+	keyboard.open();
+	lightguide keys(lightguide::firstNoteOf(usbTransport::keyCount(keyboard.productId())));
+	keys.addChase(lightguide::cyan, 24, 8, 0);
+	static const int levels[8] = { 3, 3, 2, 2, 1, 1, 0, 0 };
+	static const qint64 times[5] = { 0, 500, 1000, 3700, 4000 };
+	for(int t=0;t<5;t++)
+		{
+		int head = int(times[t]*24/1000) % lightguide::maxKeys;
+		QByteArray expected(1+lightguide::maxKeys, '\0');
+		expected[0] = 0x81;
+		for(int i=0;i<8;i++)
+			expected[1+(head-i+lightguide::maxKeys)%lightguide::maxKeys] = lightguide::cyan+levels[i];
+		if(!sendAndCompare(keyboard, keys.frame(times[t]), expected, "chase at " + QString::number(times[t]) + " ms", out))
+			failed++;
+		reports++;
+		}
+	keyboard.close();
+
+	out << "lightguide: " << reports-failed << " of " << reports << " reports as expected\n";
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include "checks.h"
+
+// reproducible measurements of the keyboard I/O paths, against the stand-in transport unless a keyboard is asked for
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QStringList arguments = app.arguments().mid(1);
+	QString check = arguments.isEmpty() ? QString() : arguments.takeFirst();
+
+	if(check == "rate")
+		return displayRate(arguments);
+	if(check == "kernels")
+		return pixelKernels(arguments);
+	if(check == "roundtrip")
+		return rleRoundTrip(arguments);
+	if(check == "fuzz")
+		return decoderFuzz(arguments);
+	if(check == "lightguide")
+		return lightguideReports(arguments);
+
+	QTextStream(stderr) << "usage: kontrolcheck <check> [options]\n"
+		<< "  rate [frames] [--keyboard]  display frames per second: reopened for every frame against one session\n"
+		<< "  kernels [rounds]            the SIMD pixel packers against the scalar one, bytes and throughput\n"
+		<< "  roundtrip [frames]          encoded frames with repeat blocks decode to their pixels again\n"
+		<< "  fuzz [reports]              random input reports through the HID decoder, state and events checked\n"
+		<< "  lightguide                  scale and chase reports per keyboard model through the stand-in\n";
+	return 2;
+}
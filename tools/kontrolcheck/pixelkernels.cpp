@@ -0,0 +1,103 @@
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QTextStream>
+#include <QVector>
+#include "displayencoder.h"
+#include "checks.h"
+
+// a 480x272 test screen: noise, solid bands (repeat blocks) and a gradient
+static QImage testScreen(quint32 seed)
+{
+	QImage image(480, 272, QImage::Format_RGB16);
+	for(int y=0;y<image.height();y++)
+		{
+		ushort *line = reinterpret_cast<ushort *>(image.scanLine(y));
+		for(int x=0;x<image.width();x++)
+			{
+			seed = seed*1664525+1013904223;
+			if((y/17) % 3 == 0)
+				line[x] = seed >> 16;
+			else if((y/17) % 3 == 1)
+				line[x] = (x < 200) ? 0x0000 : 0xf81f;
+			else
+				line[x] = x*65535/479;
+			}
+		}
+	return image;
+}
+
+// the encoded command of an area with the current kernel
+static QByteArray encoded(const QImage &image, const QRect &area)
+{
+	QByteArray frame(displayEncoder::frameSize(area.width(), area.height()), Qt::Uninitialized);
+	frame.resize(displayEncoder::encode(reinterpret_cast<uchar *>(frame.data()), 0, image, area.x(), area.y(), area));
+	return frame;
+}
+
+// every kernel the CPU supports has to produce the bytes of the scalar one: packed runs of all lengths
+// and offsets (the SIMD loops and their tails) and complete commands of screens and odd sub-rectangles.
+// afterwards the throughput of each kernel for a full screen is measured
+int pixelKernels(const QStringList &arguments)
+{
+	QTextStream out(stdout);
+	int rounds = 2000;
+	for(const QString &argument : arguments)
+		if(argument.toInt() > 0)
+			rounds = argument.toInt();
+
+	const QStringList kernels = displayEncoder::kernelNames();
+	QList<QImage> screens;
+	for(quint32 seed=1;seed<=4;seed++)
+		screens.append(testScreen(seed));
+	QList<QRect> areas;
+	areas << QRect(0, 0, 480, 272) << QRect(1, 3, 33, 18) << QRect(7, 40, 2, 1) << QRect(17, 100, 463, 56) << QRect(250, 0, 230, 1);
+
+	// reference output of the scalar kernel
+	displayEncoder::setKernel("scalar");
+	const ushort *pixels = reinterpret_cast<const ushort *>(screens.first().constBits());
+	QList<QByteArray> packed, commands;
+	for(int offset=0;offset<32;offset++)
+		for(int count=0;count<=96;count++)
+			{
+			QByteArray bytes(2*count, 0);
+			displayEncoder::packPixels(reinterpret_cast<uchar *>(bytes.data()), pixels+offset, count);
+			packed.append(bytes);
+			}
+	for(const QImage &screen : screens)
+		for(const QRect &area : areas)
+			commands.append(encoded(screen, area));
+
+	int mismatches = 0;
+	for(const QString &kernel : kernels)
+		{
+		displayEncoder::setKernel(kernel);
+		int differ = 0, i = 0;
+		for(int offset=0;offset<32;offset++)
+			for(int count=0;count<=96;count++)
+				{
+				QByteArray bytes(2*count, 0);
+				displayEncoder::packPixels(reinterpret_cast<uchar *>(bytes.data()), pixels+offset, count);
+				if(bytes != packed[i++])
+					differ++;
+				}
+		i = 0;
+		for(const QImage &screen : screens)
+			for(const QRect &area : areas)
+				if(encoded(screen, area) != commands[i++])
+					differ++;
+		mismatches += differ;
+
+		// throughput of packing one full screen
+		QVector<uchar> buffer(480*272*2);
+		QElapsedTimer timer;
+		timer.start();
+		for(int round=0;round<rounds;round++)
+			displayEncoder::packPixels(buffer.data(), pixels, 480*272);
+		double seconds = qMax<qint64>(1, timer.nsecsElapsed())/1e9;
+		out << "kernels: " << kernel << (differ ? " DIFFERS from scalar in " + QString::number(differ) + " cases, " : " matches scalar, ")
+			<< qRound(rounds*480*272*2/seconds/1e6) << " MB/s, " << qRound(rounds/seconds) << " screens/s\n";
+		}
+	displayEncoder::setKernel(kernels.last());
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+#include <string.h>
+#include <QByteArray>
+#include <QImage>
+#include <QTextStream>
+#include <QVector>
+#include <QtEndian>
+#include "displayencoder.h"
+#include "checks.h"
+
+// the pixels a 0x84 command draws, as the display reads it: header, literal (00) and repeat (01) blocks
+// counted in pixel pairs, trailer. false if the command is malformed or does not match area
+static bool decode(const QByteArray &command, const QRect &area, QVector<ushort> &pixels)
+{
+	const uchar *p = reinterpret_cast<const uchar *>(command.constData());
+	const int size = command.count();
+	static const uchar trailer[12] = { 0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00 };
+	if((size < 32) || (p[0] != 0x84) || (p[3] != 0x60) || (p[16] != 0x02))
+		return false;
+	if((qFromBigEndian<quint16>(p+8) != area.x()) || (qFromBigEndian<quint16>(p+10) != area.y()) || (qFromBigEndian<quint16>(p+12) != area.width()) || (qFromBigEndian<quint16>(p+14) != area.height()))
+		return false;
+
+	pixels.clear();
+	int at = 20;
+	while((at+4 <= size-12) && (p[at] != 0x02))
+		{
+		const int count = (p[at+1] << 16) | (p[at+2] << 8) | p[at+3];
+		if(p[at] == 0x00)
+			{
+			if(at+4+4*count > size-12)
+				return false;
+			for(int i=0;i<2*count;i++)
+				pixels.append(qFromBigEndian<quint16>(p+at+4+2*i));
+			at += 4+4*count;
+			}
+		else if(p[at] == 0x01)
+			{
+			for(int i=0;i<count;i++)
+				{
+				pixels.append(qFromBigEndian<quint16>(p+at+4));
+				pixels.append(qFromBigEndian<quint16>(p+at+6));
+				}
+			at += 8;
+			}
+		else
+			return false;
+		}
+	return (at == size-12) && (memcmp(p+at, trailer, sizeof(trailer)) == 0) && (pixels.count() == area.width()*area.height());
+}
+
+// solid runs of random length and colour (mostly black) between stretches of noise, as mixed as the screens get
+static QImage mixedScreen(quint32 &seed)
+{
+	QImage image(480, 272, QImage::Format_RGB16);
+	ushort colour = 0;
+	bool solid = true;
+	int run = 0;
+	for(int y=0;y<image.height();y++)
+		{
+		ushort *line = reinterpret_cast<ushort *>(image.scanLine(y));
+		for(int x=0;x<image.width();x++)
+			{
+			seed = seed*1664525+1013904223;
+			if(run-- <= 0)
+				{
+				run = (seed >> 8) % 64;
+				solid = (seed >> 20) & 3;
+				colour = ((seed >> 22) & 1) ? 0 : (seed >> 16);
+				}
+			line[x] = solid ? colour : (seed >> 16);
+			}
+		}
+	return image;
+}
+
+// random frames and areas are encoded and decoded again, the pixels have to come back unchanged and
+// the hybrid command must never be larger than the literal one. odd pixel counts have to be refused
+int rleRoundTrip(const QStringList &arguments)
+{
+	QTextStream out(stdout);
+	int frames = 200;
+	for(const QString &argument : arguments)
+		if(argument.toInt() > 0)
+			frames = argument.toInt();
+
+	quint32 seed = 1;
+	int failed = 0;
+	qint64 bytes = 0, literal = 0;
+	for(int i=0;i<frames;i++)
+		{
+		QImage image = mixedScreen(seed);
+		seed = seed*1664525+1013904223;
+		QRect area(0, 0, 480, 272);
+		if(i % 2)
+			{
+			// a sub-rectangle of even width, the encoder refuses odd pixel counts
+			int x = (seed >> 8) % 479, y = (seed >> 20) % 272;
+			area = QRect(x, y, 2+2*((seed >> 4) % ((480-x)/2)), 1+(seed >> 12) % (272-y));
+			}
+
+		QByteArray command(displayEncoder::frameSize(area.width(), area.height()), Qt::Uninitialized);
+		command.resize(displayEncoder::encode(reinterpret_cast<uchar *>(command.data()), 1, image, area.x(), area.y(), area));
+		QVector<ushort> pixels;
+		bool same = decode(command, area, pixels);
+		for(int y=0; same && (y<area.height()); y++)
+			same = memcmp(pixels.constData()+y*area.width(), reinterpret_cast<const ushort *>(image.constScanLine(area.y()+y))+area.x(), 2*area.width()) == 0;
+		if(!same || (command.count() > displayEncoder::frameSize(area.width(), area.height())))
+			{
+			out << "roundtrip: frame " << i << " area " << area.x() << "," << area.y() << " " << area.width() << "x" << area.height() << " does not decode to its pixels\n";
+			failed++;
+			}
+		bytes += command.count();
+		literal += displayEncoder::frameSize(area.width(), area.height());
+		}
+
+	uchar odd[64];
+	if(displayEncoder::encode(odd, 0, QImage(3, 1, QImage::Format_RGB16), 0, 0) >= 0)
+		{
+		out << "roundtrip: an odd number of pixels was encoded\n";
+		failed++;
+		}
+
+	out << "roundtrip: " << frames-failed << " of " << frames << " frames decoded to their pixels, " << bytes << " bytes instead of " << literal << " literal\n";
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,450 @@
+#include <stdio.h>
+#include <string.h>
+#include <QDebug>
+#include <QList>
+#include <QMutexLocker>
+#include "usbtransport.h"
+
+// the device ids for 49-, 61- and 88-key versions
+static const QList<int> &supportedIds()
+{
+	static const QList<int> pids = QList<int>() << 0x1860 << 0x1610 << 0x1620 << 0x1630;
+	return pids;
+}
+
+// a HID path from hid_enumerate() selects one of several connected keyboards,
+// without it the first supported keyboard is used
+usbTransport::usbTransport(const QString &hidPath, int productId)
+{
+	path = hidPath;
+	pid = productId;
+	handle = NULL;
+	ctx = NULL;
+	dev_handle = NULL;
+	inFlight = 0;
+	haltError = 0;
+	haltTag = 0;
+	flushError = 0;
+
+	// QKONTROL_USB_QUEUE_DEPTH=<transfers> changes how many chunks are in flight, 0 turns streaming off
+	depth = chunk = 0;
+	setStreaming(qEnvironmentVariableIsSet("QKONTROL_USB_QUEUE_DEPTH") ? qgetenv("QKONTROL_USB_QUEUE_DEPTH").toInt() : 4);
+}
+
+// search for the usb device and open it, the first supported model wins
+bool usbTransport::open()
+{
+	if(!path.isEmpty())
+		{
+		handle = hid_open_path(path.toLocal8Bit().constData());
+		return handle != NULL;
+		}
+	for(int i=0; i<supportedIds().count(); i++)
+		{
+		pid = supportedIds()[i];
+		handle = hid_open(0x17cc, pid, NULL);
+		if(handle)
+			return true;
+		}
+	pid = 0;
+	return false;
+}
+
+// the keyboard shows up under a new path after it was reconnected, takes effect on the next open()
+void usbTransport::setPath(const QString &hidPath, int productId)
+{
+	path = hidPath;
+	pid = productId;
+}
+
+bool usbTransport::isSupported(int productId)
+{
+	return supportedIds().contains(productId);
+}
+
+// the number of keys of a model, 0 if the product ID doesn't tell
+int usbTransport::keyCount(int productId)
+{
+	switch(productId)
+		{
+		case 0x1610: return 49;
+		case 0x1620: return 61;
+		case 0x1630: return 88;
+		default: return 0;
+		}
+}
+
+void usbTransport::close()
+{
+	detachDisplay();
+	if(ctx)
+		{
+		libusb_exit(ctx);
+		ctx = NULL;
+		}
+	if(handle)
+		{
+		hid_close(handle);
+		handle = NULL;
+		}
+}
+
+int usbTransport::readReport(unsigned char *data, int length, int timeout)
+{
+	if(!handle)
+		return -1;
+	return hid_read_timeout(handle, data, length, timeout);
+}
+
+int usbTransport::writeReport(const unsigned char *data, int length)
+{
+	if(!handle)
+		return -1;
+	return hid_write(handle, data, length);
+}
+
+// open the device with libusb and claim the display interface, the handle stays valid until detachDisplay() or a disconnect
+bool usbTransport::attachDisplay()
+{
+	QMutexLocker locker(&displayLock);
+	if(dev_handle)
+		return true;
+	if(!ctx)
+		if(libusb_init(&ctx) < 0)
+			{
+			ctx = NULL;
+			return false;
+			}
+	if(!pid)
+		return false;
+
+	dev_handle = openDisplayDevice();
+	depth = requestedDepth;
+	chunk = requestedChunk;
+	if(dev_handle == NULL)
+		{
+		qDebug() << "display: cannot open device";
+		return false;
+		}
+	if(libusb_claim_interface(dev_handle, 3) < 0) // interface 3 carries the bulk endpoint of the screens
+		{
+		qDebug() << "display: cannot claim interface 3";
+		libusb_close(dev_handle);
+		dev_handle = NULL;
+		return false;
+		}
+	return true;
+}
+
+// the libusb device which belongs to the opened HID device: hidapi's libusb backend names devices
+// "bus:address:interface" (hex), other backends fall back to the first device with the product ID
+libusb_device_handle *usbTransport::openDisplayDevice()
+{
+	int bus, address, hidInterface;
+	if(sscanf(path.toLatin1().constData(), "%x:%x:%x", &bus, &address, &hidInterface) != 3)
+		return libusb_open_device_with_vid_pid(ctx, 0x17cc, pid); // vendor ID 0x17cc = Native Instruments
+
+	libusb_device **list;
+	libusb_device_handle *device = NULL;
+	ssize_t count = libusb_get_device_list(ctx, &list);
+	for(ssize_t i=0; (i<count) && !device; i++)
+		if((libusb_get_bus_number(list[i]) == bus) && (libusb_get_device_address(list[i]) == address))
+			if(libusb_open(list[i], &device) < 0)
+				device = NULL;
+	if(count >= 0)
+		libusb_free_device_list(list, 1);
+	return device;
+}
+
+// a stalled device returns LIBUSB_ERROR_TIMEOUT after timeout milliseconds (0 waits forever). in streaming
+// mode 1 means the command is in flight, displayResults() reports it under tag
+int usbTransport::writeDisplay(quint64 tag, const unsigned char *data, int length, int timeout)
+{
+	// the device may have been unplugged and reconnected since the last frame
+	if(!attachDisplay())
+		return LIBUSB_ERROR_NO_DEVICE;
+
+	int r;
+	if(depth > 0)
+		r = stream(tag, data, length, timeout);
+	else
+		{
+		int actual; // used to find out how many bytes were written
+		r = libusb_bulk_transfer(dev_handle, 3, (unsigned char*) data, length, &actual, timeout);
+		if((r < 0) && (r != LIBUSB_ERROR_NO_DEVICE))
+			libusb_clear_halt(dev_handle, 3);
+		}
+	if(r == LIBUSB_ERROR_NO_DEVICE)
+		{
+		// drop the stale handle, the next frame tries to reopen the device
+		QMutexLocker locker(&displayLock);
+		cancelTransfers();
+		libusb_close(dev_handle);
+		dev_handle = NULL;
+		}
+	return r;
+}
+
+// wait until every streamed command is transferred, returns the first error of one of them since the last call
+int usbTransport::flushDisplay()
+{
+	if(!dev_handle)
+		return 0;
+	int r = waitForTransfers(0);
+	if(r < 0)
+		{
+		// the events can't be handled, nothing in flight will finish by itself
+		if(!commands.isEmpty())
+			resync(commands.first().tag, r);
+		settle();
+		}
+	int error = flushError ? flushError : qMin(r, 0);
+	flushError = 0;
+	return error;
+}
+
+// the streamed commands which finished meanwhile, the transfers which are done are handled without waiting
+QList<displayResult> usbTransport::displayResults()
+{
+	if(dev_handle && (inFlight > 0))
+		{
+		timeval now = { 0, 0 };
+		libusb_handle_events_timeout_completed(ctx, &now, NULL);
+		if(haltError)
+			resync(haltTag, haltError);
+		settle();
+		}
+	QList<displayResult> results = finished;
+	finished.clear();
+	return results;
+}
+
+// queueDepth transfers of chunkSize bytes may be in flight, the chunks are whole USB 2.0 packets (512 bytes),
+// so the device sees the same packet stream as with one transfer per command. takes effect when the display
+// is attached the next time, the transfers in use keep their buffers until then
+void usbTransport::setStreaming(int queueDepth, int chunkSize)
+{
+	QMutexLocker locker(&displayLock);
+	requestedDepth = qMax(0, queueDepth);
+	requestedChunk = qMax(512, chunkSize - chunkSize % 512);
+	if(!dev_handle)
+		{
+		depth = requestedDepth;
+		chunk = requestedChunk;
+		}
+}
+
+// split a display command into chunks and submit them, waiting only while all transfers are in flight (the
+// chunks of the commands before it count as well). returns 1 when the last chunk is submitted, or 0 or the
+// error of the command if it already finished meanwhile
+int usbTransport::stream(quint64 tag, const unsigned char *data, int length, int timeout)
+{
+	streamedCommand started = { tag, 0, 0, true };
+	commands.append(started);
+	for(int offset=0; offset<length; offset+=chunk)
+		{
+		int r = waitForTransfers(depth-1);
+		if(r < 0)
+			resync(tag, r);
+		if(commands[command(tag)].error)
+			break; // cut off, the rest of it is not sent
+
+		// transfers and their buffers are allocated once and reused
+		if(idle.isEmpty())
+			{
+			libusb_transfer *transfer = libusb_alloc_transfer(0);
+			if(!transfer)
+				{
+				resync(tag, LIBUSB_ERROR_NO_MEM);
+				break;
+				}
+			transfer->buffer = new unsigned char[chunk];
+			transfer->length = chunk;
+			transfers.append(transfer);
+			idle.append(transfer);
+			}
+		libusb_transfer *transfer = idle.takeLast();
+		int size = qMin(chunk, length-offset);
+		memcpy(transfer->buffer, data+offset, size);
+		libusb_fill_bulk_transfer(transfer, dev_handle, 3, transfer->buffer, size, transferDone, this, timeout);
+		r = libusb_submit_transfer(transfer);
+		if(r < 0)
+			{
+			idle.append(transfer);
+			resync(tag, r);
+			break;
+			}
+		tags[transfer] = tag;
+		commands[command(tag)].chunks++;
+		inFlight++;
+		}
+
+	int i = command(tag);
+	commands[i].submitting = false;
+	if(commands[i].chunks > 0)
+		return 1;
+	// everything of it is back already (or was never sent), it is not reported again
+	int r = commands.takeAt(i).error;
+	return r;
+}
+
+// the index of a command in commands
+int usbTransport::command(quint64 tag) const
+{
+	for(int i=0;i<commands.count();i++)
+		if(commands[i].tag == tag)
+			return i;
+	return -1;
+}
+
+// a chunk of the command tag failed (or could not be sent): it and every later command are cut off, their
+// chunks still in flight are cancelled and the endpoint is reset once, so the device does not take the next
+// command for the missing part of this one. the commands before it are not touched. returns error
+int usbTransport::resync(quint64 tag, int error)
+{
+	int first = command(tag);
+	if(first < 0)
+		return error;
+	if(!commands[first].error)
+		commands[first].error = error;
+	// an earlier command which failed meanwhile is cut off in the same go
+	int halted = haltError ? command(haltTag) : -1;
+	if((halted >= 0) && (halted < first))
+		first = halted;
+	haltError = 0;
+	// the later ones are not at fault, a cancelled chunk of them must not count as a new failure
+	for(int i=first+1;i<commands.count();i++)
+		if(!commands[i].error)
+			commands[i].error = LIBUSB_ERROR_INTERRUPTED;
+	for(QHash<libusb_transfer *, quint64>::const_iterator i = tags.constBegin(); i != tags.constEnd(); ++i)
+		if(command(i.value()) >= first)
+			libusb_cancel_transfer(i.key());
+	forever
+		{
+		int left = 0;
+		for(int i=first;i<commands.count();i++)
+			left += commands[i].chunks;
+		if(!left || (libusb_handle_events(ctx) < 0))
+			break;
+		}
+	if(error != LIBUSB_ERROR_NO_DEVICE)
+		libusb_clear_halt(dev_handle, 3);
+	return error;
+}
+
+// handle finished transfers until at most maximum are in flight, a failed chunk cuts its command off on the
+// way. returns an error of the event handling, the results of the commands go to displayResults()
+int usbTransport::waitForTransfers(int maximum)
+{
+	while(inFlight > qMax(0, maximum))
+		{
+		int r = libusb_handle_events(ctx); // every transfer has a timeout, so this returns
+		if((r < 0) && (r != LIBUSB_ERROR_INTERRUPTED))
+			return r;
+		if(haltError)
+			resync(haltTag, haltError);
+		}
+	if(haltError)
+		resync(haltTag, haltError);
+	settle();
+	return 0;
+}
+
+// the commands whose chunks are all back are finished, oldest first
+void usbTransport::settle()
+{
+	for(int i=0;i<commands.count();)
+		{
+		if(commands[i].submitting || commands[i].chunks)
+			{
+			i++;
+			continue;
+			}
+		displayResult result = { commands[i].tag, commands[i].error };
+		if(result.result && !flushError)
+			flushError = result.result;
+		finished.append(result);
+		commands.removeAt(i);
+		}
+}
+
+// called from libusb_handle_events() (waitForTransfers(), resync(), displayResults()), so always on the thread which streams
+void LIBUSB_CALL usbTransport::transferDone(libusb_transfer *transfer)
+{
+	usbTransport *self = static_cast<usbTransport *>(transfer->user_data);
+	self->inFlight--;
+	self->idle.append(transfer);
+	quint64 tag = self->tags.take(transfer);
+	int error;
+	switch(transfer->status)
+		{
+		case LIBUSB_TRANSFER_COMPLETED: error = 0; break;
+		case LIBUSB_TRANSFER_CANCELLED: error = LIBUSB_ERROR_INTERRUPTED; break;
+		case LIBUSB_TRANSFER_TIMED_OUT: error = LIBUSB_ERROR_TIMEOUT; break;
+		case LIBUSB_TRANSFER_NO_DEVICE: error = LIBUSB_ERROR_NO_DEVICE; break;
+		case LIBUSB_TRANSFER_STALL: error = LIBUSB_ERROR_PIPE; break;
+		case LIBUSB_TRANSFER_OVERFLOW: error = LIBUSB_ERROR_OVERFLOW; break;
+		default: error = LIBUSB_ERROR_IO; break;
+		}
+	int i = self->command(tag);
+	if(i < 0)
+		return;
+	self->commands[i].chunks--;
+	if(error && !self->commands[i].error)
+		{
+		self->commands[i].error = error;
+		// the first real failure cuts off its command and the ones behind it, once the events are handled
+		if((error != LIBUSB_ERROR_INTERRUPTED) && !self->haltError)
+			{
+			self->haltError = error;
+			self->haltTag = tag;
+			}
+		}
+}
+
+// cancel everything still in flight and wait for it, the buffers and the device handle must outlive the transfers.
+// the commands in flight are given up without a result
+void usbTransport::cancelTransfers()
+{
+	for(libusb_transfer *transfer : transfers)
+		if(!idle.contains(transfer))
+			libusb_cancel_transfer(transfer);
+	while(inFlight > 0)
+		if(libusb_handle_events(ctx) < 0)
+			break;
+	for(libusb_transfer *transfer : transfers)
+		{
+		delete[] transfer->buffer;
+		transfer->buffer = NULL;
+		libusb_free_transfer(transfer);
+		}
+	transfers.clear();
+	idle.clear();
+	tags.clear();
+	commands.clear();
+	finished.clear();
+	inFlight = 0;
+	haltError = 0;
+	flushError = 0;
+}
+
+void usbTransport::detachDisplay()
+{
+	QMutexLocker locker(&displayLock);
+	if(!dev_handle)
+		return;
+	cancelTransfers();
+	libusb_release_interface(dev_handle, 3);
+	libusb_close(dev_handle);
+	dev_handle = NULL;
+}
+
+int usbTransport::productId() const
+{
+	return pid;
+}
+
+usbTransport::~usbTransport()
+{
+	close();
+}
@@ -0,0 +1,80 @@
+#ifndef _USBTRANSPORT_H_
+#define _USBTRANSPORT_H_
+
+#include <QtGlobal>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#ifdef Q_OS_MACOS
+#include "/usr/local/Cellar/hidapi/0.9.0/include/hidapi/hidapi.h"
+#include "/usr/local/Cellar/libusb/1.0.22/include/libusb-1.0/libusb.h"
+#else
+#include <hidapi/hidapi.h>
+#include <libusb-1.0/libusb.h>
+#endif
+#include "kontroltransport.h"
+
+// the real keyboard: reports through hidapi, screens through libusb bulk transfers on interface 3.
+// in streaming mode a display command is split into chunks which are sent as asynchronous
+// transfers. writeDisplay() returns once the last chunk is submitted, so the chunks of the next
+// commands queue up behind it and the bus does not idle between two chunks or two commands.
+// every transfer carries the tag of its command, a failure is reported for that command
+class usbTransport : public kontrolTransport
+{
+	public:
+		explicit usbTransport(const QString &hidPath = QString(), int productId = 0);
+		~usbTransport();
+		bool open();
+		void close();
+		int readReport(unsigned char *data, int length, int timeout);
+		int writeReport(const unsigned char *data, int length);
+		bool attachDisplay();
+		int writeDisplay(quint64 tag, const unsigned char *data, int length, int timeout);
+		void detachDisplay();
+		int flushDisplay();
+		QList<displayResult> displayResults();
+		void setStreaming(int queueDepth, int chunkSize = 65536);
+		int productId() const;
+		void setPath(const QString &hidPath, int productId);
+		static bool isSupported(int productId);
+		static int keyCount(int productId);
+
+	private:
+		// a streamed display command while chunks of it are in flight
+		struct streamedCommand
+			{
+			quint64 tag;
+			int chunks; // in flight
+			int error; // of the first failed chunk, LIBUSB_ERROR_INTERRUPTED if it was cancelled for an earlier one
+			bool submitting; // stream() still adds chunks
+			};
+
+		libusb_device_handle *openDisplayDevice();
+		int stream(quint64 tag, const unsigned char *data, int length, int timeout);
+		int waitForTransfers(int maximum);
+		int command(quint64 tag) const;
+		void settle();
+		void cancelTransfers();
+		int resync(quint64 tag, int error);
+		static void LIBUSB_CALL transferDone(libusb_transfer *transfer);
+
+		QString path;
+		int pid;
+		hid_device *handle;
+		libusb_context *ctx;
+		libusb_device_handle *dev_handle;
+		QMutex displayLock;
+		int depth, chunk; // transfers in flight at most and bytes per transfer, depth 0 sends synchronously
+		int requestedDepth, requestedChunk;
+		QList<libusb_transfer *> transfers, idle;
+		QHash<libusb_transfer *, quint64> tags; // command of every transfer in flight
+		QList<streamedCommand> commands; // in the order they were written
+		QList<displayResult> finished; // for displayResults()
+		int inFlight;
+		int haltError; // a chunk failed, the commands from haltTag on have to be cut off
+		quint64 haltTag;
+		int flushError; // first error of a finished command since the last flushDisplay()
+};
+
+#endif /*_USBTRANSPORT_H_*/
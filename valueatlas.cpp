@@ -0,0 +1,46 @@
+#include <QFont>
+#include <QPainter>
+#include "valueatlas.h"
+
+valueAtlas::valueAtlas()
+{
+	builds = 0;
+	tiles.resize(128);
+}
+
+// nothing happens if the color did not change
+void valueAtlas::setColor(const QColor &color)
+{
+	if((color == textColor) && (builds > 0))
+		return;
+	textColor = color;
+	build();
+}
+
+// values above 127 show as 127, like the MIDI value they stand for
+const QImage &valueAtlas::tile(quint8 value) const
+{
+	return tiles[qMin<int>(value, 127)];
+}
+
+quint64 valueAtlas::buildCount() const
+{
+	return builds;
+}
+
+// render every value right aligned on black with one painter and convert it to the screen format
+void valueAtlas::build()
+{
+	QImage canvas(tileWidth, tileHeight, QImage::Format_RGB32);
+	QPainter painter(&canvas);
+	painter.setFont(QFont("Arial", 14, QFont::Bold));
+	painter.setPen(textColor);
+	for(int value=0;value<128;value++)
+		{
+		painter.fillRect(canvas.rect(), Qt::black);
+		painter.drawText(QRect(0, 0, tileWidth-2, tileHeight), Qt::AlignRight, QString::number(value));
+		tiles[value] = canvas.convertToFormat(QImage::Format_RGB16);
+		}
+	painter.end();
+	builds++;
+}
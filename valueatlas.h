@@ -0,0 +1,31 @@
+#ifndef _VALUEATLAS_H_
+#define _VALUEATLAS_H_
+
+#include <QtGlobal>
+#include <QColor>
+#include <QImage>
+#include <QVector>
+
+// the knob value overlays (0-127) rendered once in the RGB565 format of the screens: showing a value
+// hands a ready tile to the encoder, no font lookup or painting on the way. the tiles are only
+// rendered again when the text color changes
+class valueAtlas
+{
+	public:
+		static const int tileWidth = 32;
+		static const int tileHeight = 18;
+
+		valueAtlas();
+		void setColor(const QColor &color);
+		const QImage &tile(quint8 value) const;
+		quint64 buildCount() const;
+
+	private:
+		void build();
+
+		QColor textColor;
+		QVector<QImage> tiles;
+		quint64 builds;
+};
+
+#endif /*_VALUEATLAS_H_*/